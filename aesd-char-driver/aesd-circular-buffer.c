@@ -38,37 +38,45 @@ struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct
         return NULL;
     }
 
-    size_t byte_to_ret = 0;
-    size_t offset = 0;
-    size_t idx = buffer->out_offs;
-    bool   found_match = false;
+    // Entries are addressed by their monotonic offsets, so the search runs over the
+    // dense entry_end array in oldest to newest order and stops at the first entry
+    // ending past the target.  An empty buffer has in_fpos == out_fpos.
+    if (char_offset >= buffer->in_fpos - buffer->out_fpos)
+    {
+        return NULL;
+    }
 
-    // Want to capture the first check of whether offset is found
-    do
+    uint64_t target = buffer->out_fpos + char_offset;
+    size_t low = 0;
+    size_t high = aesd_circular_buffer_entry_count(buffer);
+    size_t idx;
+
+    while (low < high)
     {
-        // Increment overall offset by the size of this buffer entry
-        offset += buffer->entry[idx].size;
-        byte_to_ret = buffer->entry[idx].size;
-        // If we've passed the desired offset, success
-        if (offset > char_offset)
+        size_t mid = low + (high - low) / 2;
+
+        idx = buffer->out_offs + mid;
+        if (idx >= AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED)
         {
-            found_match = true;
-            byte_to_ret -= (offset-char_offset);
-            break;
+            idx -= AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
         }
+        if (buffer->entry_end[idx] > target)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
 
-        // Increment index, accounting for wraparound
-        idx++;
-        idx %= AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-    } while (idx != buffer->in_offs);
-
-    // Return null if no offset was found
-    if (!found_match)
+    idx = buffer->out_offs + low;
+    if (idx >= AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED)
     {
-        return NULL;
+        idx -= AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
     }
 
-    *entry_offset_byte_rtn = byte_to_ret;
+    *entry_offset_byte_rtn = target - (buffer->entry_end[idx] - buffer->entry[idx].size);
     return buffer->entry + idx;
 }
 
@@ -93,13 +101,18 @@ const char *aesd_circular_buffer_add_entry(struct aesd_circular_buffer *buffer,
     }
     
     // If buffer is full, save off the pointer that we're going to return
+    // and move the absolute position of the oldest data past the evicted entry
     if (buffer->full)
     {
         buf_to_ret = buffer->entry[buffer->in_offs].buffptr;
+        buffer->out_fpos += buffer->entry[buffer->in_offs].size;
+        buffer->out_seq++;
     }
+    buffer->in_fpos += add_entry->size;
 
     // Add the entry to buffer and increment offset for the next addition
     buffer->entry[buffer->in_offs] = *add_entry;
+    buffer->entry_end[buffer->in_offs] = buffer->in_fpos;
     buffer->in_offs++;
     buffer->in_offs = buffer->in_offs % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
 
@@ -118,6 +131,35 @@ const char *aesd_circular_buffer_add_entry(struct aesd_circular_buffer *buffer,
     return buf_to_ret;
 }
 
+/**
+* Removes the oldest entry from @param buffer, advancing buffer->out_offs past it.
+* Any necessary locking must be handled by the caller
+* @param removed_entry receives the entry that was removed, whose memory the caller now owns
+* @return false if @param buffer was empty
+*/
+bool aesd_circular_buffer_remove_entry(struct aesd_circular_buffer *buffer, struct aesd_buffer_entry *removed_entry)
+{
+    if (!buffer || (!buffer->full && (buffer->in_offs == buffer->out_offs)))
+    {
+        return false;
+    }
+
+    if (removed_entry)
+    {
+        *removed_entry = buffer->entry[buffer->out_offs];
+    }
+    buffer->out_fpos += buffer->entry[buffer->out_offs].size;
+    buffer->out_seq++;
+    buffer->entry[buffer->out_offs].buffptr = NULL;
+    buffer->entry[buffer->out_offs].size = 0;
+
+    buffer->out_offs++;
+    buffer->out_offs = buffer->out_offs % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+    buffer->full = false;
+
+    return true;
+}
+
 /**
 * Initializes the circular buffer described by @param buffer to an empty struct
 */
@@ -125,3 +167,16 @@ void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer)
 {
     memset(buffer,0,sizeof(struct aesd_circular_buffer));
 }
+
+/**
+* @return the number of entries currently held in @param buffer
+*/
+uint8_t aesd_circular_buffer_entry_count(const struct aesd_circular_buffer *buffer)
+{
+    if (buffer->full)
+    {
+        return AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+    }
+    return (buffer->in_offs + AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED - buffer->out_offs) %
+           AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+}
@@ -16,7 +16,10 @@
 #include <stdbool.h>
 #endif
 
+// May be overridden at build time (up to 255, the offsets are uint8_t), e.g. by the userspace benchmark
+#ifndef AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED
 #define AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED 10
+#endif
 
 struct aesd_buffer_entry
 {
@@ -30,12 +33,20 @@ struct aesd_buffer_entry
     size_t size;
 };
 
+#ifdef __KERNEL__
+#include <linux/cache.h>
+#define AESD_CACHELINE_ALIGNED ____cacheline_aligned_in_smp
+#else
+#define AESD_CACHELINE_ALIGNED __attribute__((aligned(64)))
+#endif
+
+/*
+ * The index fields every add and lookup touch come first on their own cache line.
+ * Lookups then scan only the dense entry_end array and touch a single entry[] slot
+ * for the match, instead of striding through pointer/size pairs.
+ */
 struct aesd_circular_buffer
 {
-    /**
-     * An array of pointers to memory allocated for the most recent write operations
-     */
-    struct aesd_buffer_entry  entry[AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED];
     /**
      * The current location in the entry structure where the next write should
      * be stored.
@@ -49,6 +60,30 @@ struct aesd_circular_buffer
      * set to true when the buffer entry structure is full
      */
     bool full;
+    /**
+     * Monotonic byte offset of the first byte of the entry at out_offs, which is the
+     * total number of bytes ever evicted.  Offsets never move once assigned, so
+     * entry data can be addressed the same way no matter how often the buffer wraps.
+     */
+    uint64_t out_fpos;
+    /**
+     * Monotonic byte offset one past the last byte of the newest entry
+     */
+    uint64_t in_fpos;
+    /**
+     * Sequence number of the entry at out_offs.  Entries are numbered consecutively
+     * in the order they were added, starting from 0.
+     */
+    uint64_t out_seq;
+    /**
+     * Monotonic byte offset one past the last byte of each entry, indexed like entry[].
+     * Read from out_offs these are sorted, so a position is located by searching here.
+     */
+    uint64_t entry_end[AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED] AESD_CACHELINE_ALIGNED;
+    /**
+     * An array of pointers to memory allocated for the most recent write operations
+     */
+    struct aesd_buffer_entry  entry[AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED] AESD_CACHELINE_ALIGNED;
 };
 
 extern struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct aesd_circular_buffer *buffer,
@@ -56,8 +91,12 @@ extern struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos
 
 extern const char *aesd_circular_buffer_add_entry(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entry);
 
+extern bool aesd_circular_buffer_remove_entry(struct aesd_circular_buffer *buffer, struct aesd_buffer_entry *removed_entry);
+
 extern void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer);
 
+extern uint8_t aesd_circular_buffer_entry_count(const struct aesd_circular_buffer *buffer);
+
 /**
  * Create a for loop to iterate over each member of the circular buffer.
  * Useful when you've allocated memory for circular buffer entries and need to free it
@@ -0,0 +1,161 @@
+/**
+ * @file aesd-delim.c
+ * @brief Single pass search for every record delimiter in a block
+ *
+ * In userspace on x86 the block is compared 32 (AVX2) or 16 (SSE2) bytes at a time and
+ * every match in a vector is taken from its compare mask, so a block holding many short
+ * records is walked once instead of once per record.  The AVX2 or SSE2 variant is picked
+ * at runtime when the CPU supports it, otherwise the memchr loop below is used.  Other architectures fall back to repeated memchr,
+ * which the C library already vectorizes.
+ *
+ * The kernel build always uses the memchr loop: vector registers are only usable
+ * between kernel_fpu_begin()/kernel_fpu_end(), which costs more than the scan saves for
+ * the record sizes written to the driver.
+ *
+ * @author Katie Biggs
+ * @date 2026-10-19
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifdef __KERNEL__
+#include <linux/string.h>
+#else
+#include <string.h>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AESD_DELIM_X86 1
+#endif
+#endif
+
+#include "aesd-delim.h"
+
+static size_t aesd_delim_scan_memchr(const char *data, size_t size, char delimiter,
+                                     size_t *positions, size_t max_positions)
+{
+    size_t found = 0;
+    size_t offset = 0;
+
+    while ((found < max_positions) && (offset < size))
+    {
+        const char *match = memchr(data + offset, delimiter, size - offset);
+        if (!match)
+        {
+            break;
+        }
+        positions[found++] = match - data;
+        offset = (match - data) + 1;
+    }
+    return found;
+}
+
+#ifdef AESD_DELIM_X86
+
+/* Store the offset of every set bit in mask, lowest first, relative to base */
+#define AESD_DELIM_TAKE_MASK(mask, base)                                   \
+    while ((mask) && (found < max_positions))                              \
+    {                                                                      \
+        positions[found++] = (base) + __builtin_ctz(mask);                 \
+        (mask) &= (mask) - 1;                                              \
+    }
+
+// i386 builds may target CPUs without SSE2, so the variant carries its own target and
+// is only picked once the CPU is known to support it
+__attribute__((target("sse2")))
+static size_t aesd_delim_scan_sse2(const char *data, size_t size, char delimiter,
+                                   size_t *positions, size_t max_positions)
+{
+    const __m128i needle = _mm_set1_epi8(delimiter);
+    size_t found = 0;
+    size_t offset = 0;
+
+    for (; (offset + 16 <= size) && (found < max_positions); offset += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + offset));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        AESD_DELIM_TAKE_MASK(mask, offset);
+    }
+    if ((found < max_positions) && (offset < size))
+    {
+        size_t tail = aesd_delim_scan_memchr(data + offset, size - offset, delimiter,
+                                             positions + found, max_positions - found);
+        for (size_t idx = found; idx < found + tail; idx++)
+        {
+            positions[idx] += offset;
+        }
+        found += tail;
+    }
+    return found;
+}
+
+__attribute__((target("avx2")))
+static size_t aesd_delim_scan_avx2(const char *data, size_t size, char delimiter,
+                                   size_t *positions, size_t max_positions)
+{
+    const __m256i needle = _mm256_set1_epi8(delimiter);
+    size_t found = 0;
+    size_t offset = 0;
+
+    for (; (offset + 32 <= size) && (found < max_positions); offset += 32)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(data + offset));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        AESD_DELIM_TAKE_MASK(mask, offset);
+    }
+    if ((found < max_positions) && (offset < size))
+    {
+        size_t tail = aesd_delim_scan_sse2(data + offset, size - offset, delimiter,
+                                           positions + found, max_positions - found);
+        for (size_t idx = found; idx < found + tail; idx++)
+        {
+            positions[idx] += offset;
+        }
+        found += tail;
+    }
+    return found;
+}
+
+typedef size_t (*aesd_delim_scan_fn)(const char *, size_t, char, size_t *, size_t);
+
+static size_t aesd_delim_scan_resolve(const char *data, size_t size, char delimiter,
+                                      size_t *positions, size_t max_positions);
+
+// starts at the resolver, which replaces it with the best variant on first use
+// racing first callers all store the same answer, so relaxed atomics are enough
+static aesd_delim_scan_fn aesd_delim_scan_impl = aesd_delim_scan_resolve;
+
+static size_t aesd_delim_scan_resolve(const char *data, size_t size, char delimiter,
+                                      size_t *positions, size_t max_positions)
+{
+    aesd_delim_scan_fn impl = aesd_delim_scan_memchr;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        impl = aesd_delim_scan_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        impl = aesd_delim_scan_sse2;
+    }
+    __atomic_store_n(&aesd_delim_scan_impl, impl, __ATOMIC_RELAXED);
+    return impl(data, size, delimiter, positions, max_positions);
+}
+
+size_t aesd_delim_scan(const char *data, size_t size, char delimiter,
+                       size_t *positions, size_t max_positions)
+{
+    aesd_delim_scan_fn impl = __atomic_load_n(&aesd_delim_scan_impl, __ATOMIC_RELAXED);
+    return impl(data, size, delimiter, positions, max_positions);
+}
+
+#else
+
+size_t aesd_delim_scan(const char *data, size_t size, char delimiter,
+                       size_t *positions, size_t max_positions)
+{
+    return aesd_delim_scan_memchr(data, size, delimiter, positions, max_positions);
+}
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * aesd-delim.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Katie Biggs
+ *
+ *  @brief Record delimiter scanning shared by the driver write path and aesdsocket
+ */
+
+#ifndef AESD_DELIM_H
+#define AESD_DELIM_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stddef.h> // size_t
+#endif
+
+/**
+ * Number of delimiter positions callers usually collect per scan.  Large enough that a
+ * block full of short records is split with a handful of scans, small enough for the
+ * kernel stack.
+ */
+#define AESD_DELIM_SCAN_BATCH 32
+
+/**
+ * Find the positions of delimiter in data in a single pass.
+ * @param data the block to search
+ * @param size number of bytes in data
+ * @param delimiter the byte to search for, '\n' for aesd records
+ * @param positions array receiving the offset from data of each delimiter found, in order
+ * @param max_positions capacity of positions.  The scan stops once it is full, so a return
+ *      value equal to max_positions means the caller should scan again from one past the
+ *      last position to find the rest.
+ * @return the number of positions stored
+ */
+extern size_t aesd_delim_scan(const char *data, size_t size, char delimiter,
+                              size_t *positions, size_t max_positions);
+
+#endif /* AESD_DELIM_H */
@@ -0,0 +1,149 @@
+/**
+ * @file aesd-entry-pool.c
+ * @brief Dedicated slab caches for aesdchar entry payloads
+ *
+ * Every payload buffer is sized to the power of two class covering the number
+ * of bytes it holds, so the owning class can always be recovered from the
+ * entry size alone and no per buffer bookkeeping is needed.  Buffers freed on
+ * eviction go back to their class cache and are handed out again for the next
+ * write, keeping steady state traffic off the general purpose allocator.
+ *
+ * @author Katie Biggs
+ * @date 2026-10-19
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include "aesd-entry-pool.h"
+
+static struct kmem_cache *aesd_entry_caches[AESD_ENTRY_POOL_NR_CLASSES];
+
+static const char * const aesd_entry_cache_names[AESD_ENTRY_POOL_NR_CLASSES] = {
+    "aesd_entry_32",
+    "aesd_entry_64",
+    "aesd_entry_128",
+    "aesd_entry_256",
+    "aesd_entry_512",
+    "aesd_entry_1024",
+    "aesd_entry_2048",
+    "aesd_entry_4096",
+};
+
+/**
+ * @return the index into aesd_entry_caches serving @param size bytes, or -1 if the
+ * size is too large for any cache
+ */
+static int aesd_entry_pool_class(size_t size)
+{
+    unsigned int shift;
+
+    if (size > (1UL << AESD_ENTRY_POOL_MAX_SHIFT))
+    {
+        return -1;
+    }
+    if (size <= (1UL << AESD_ENTRY_POOL_MIN_SHIFT))
+    {
+        return 0;
+    }
+
+    shift = order_base_2(size);
+    return shift - AESD_ENTRY_POOL_MIN_SHIFT;
+}
+
+/**
+ * Create the size class caches.  Must be called before any other pool function.
+ * @return 0 on success or a negative errno
+ */
+int aesd_entry_pool_init(void)
+{
+    int idx;
+
+    for (idx = 0; idx < AESD_ENTRY_POOL_NR_CLASSES; idx++)
+    {
+        unsigned int obj_size = 1U << (idx + AESD_ENTRY_POOL_MIN_SHIFT);
+
+        // payloads are copied to and from user space, so whitelist the whole object
+        aesd_entry_caches[idx] = kmem_cache_create_usercopy(aesd_entry_cache_names[idx],
+                                                            obj_size, 0, 0,
+                                                            0, obj_size, NULL);
+        if (!aesd_entry_caches[idx])
+        {
+            aesd_entry_pool_destroy();
+            return -ENOMEM;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Destroy the size class caches.  All buffers must have been returned to the pool.
+ */
+void aesd_entry_pool_destroy(void)
+{
+    int idx;
+
+    for (idx = 0; idx < AESD_ENTRY_POOL_NR_CLASSES; idx++)
+    {
+        kmem_cache_destroy(aesd_entry_caches[idx]);
+        aesd_entry_caches[idx] = NULL;
+    }
+}
+
+/**
+ * @return the number of bytes actually available in a buffer allocated for @param size bytes
+ */
+size_t aesd_entry_pool_capacity(size_t size)
+{
+    int class = aesd_entry_pool_class(size);
+
+    if (class < 0)
+    {
+        return roundup_pow_of_two(size);
+    }
+    return 1UL << (class + AESD_ENTRY_POOL_MIN_SHIFT);
+}
+
+/**
+ * Allocate a payload buffer able to hold @param size bytes
+ * @return the buffer or NULL on allocation failure
+ */
+char *aesd_entry_pool_alloc(size_t size, gfp_t flags)
+{
+    int class = aesd_entry_pool_class(size);
+
+    if (class < 0)
+    {
+        return kvmalloc(roundup_pow_of_two(size), flags);
+    }
+    return kmem_cache_alloc(aesd_entry_caches[class], flags);
+}
+
+/**
+ * Return @param buf to the pool.  @param size must be the number of bytes stored in
+ * the buffer, which always falls in the class it was allocated from.
+ */
+void aesd_entry_pool_free(const char *buf, size_t size)
+{
+    int class;
+
+    if (!buf)
+    {
+        return;
+    }
+
+    class = aesd_entry_pool_class(size);
+    if (class < 0)
+    {
+        kvfree(buf);
+    }
+    else
+    {
+        kmem_cache_free(aesd_entry_caches[class], (void *)buf);
+    }
+}
@@ -0,0 +1,35 @@
+/*
+ * aesd-entry-pool.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Katie Biggs
+ *
+ *  @brief Size classed allocator for aesdchar entry payloads
+ */
+
+#ifndef AESD_ENTRY_POOL_H
+#define AESD_ENTRY_POOL_H
+
+#include <linux/types.h>
+#include <linux/gfp.h>
+
+/**
+ * Payloads are served from one kmem_cache per power of two size class between
+ * 1 << AESD_ENTRY_POOL_MIN_SHIFT and 1 << AESD_ENTRY_POOL_MAX_SHIFT bytes.
+ * Anything larger falls back to kvmalloc.
+ */
+#define AESD_ENTRY_POOL_MIN_SHIFT  5
+#define AESD_ENTRY_POOL_MAX_SHIFT  12
+#define AESD_ENTRY_POOL_NR_CLASSES (AESD_ENTRY_POOL_MAX_SHIFT - AESD_ENTRY_POOL_MIN_SHIFT + 1)
+
+extern int aesd_entry_pool_init(void);
+
+extern void aesd_entry_pool_destroy(void);
+
+extern size_t aesd_entry_pool_capacity(size_t size);
+
+extern char *aesd_entry_pool_alloc(size_t size, gfp_t flags);
+
+extern void aesd_entry_pool_free(const char *buf, size_t size);
+
+#endif /* AESD_ENTRY_POOL_H */
@@ -0,0 +1,116 @@
+/*
+ * aesd-ring.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Katie Biggs
+ *
+ *  @brief Header only generator for fixed capacity rings, in the style of the
+ *  macro containers in server/queue.h.
+ *
+ *  A ring is declared for a specific element type, capacity and index type:
+ *
+ *      AESD_RING_HEAD(stamp_ring, struct timespec, 32, uint8_t);
+ *      struct stamp_ring stamps;
+ *
+ *      AESD_RING_INIT(&stamps);
+ *      AESD_RING_PUSH(&stamps, now);
+ *      AESD_RING_FOREACH(idx, &stamps)
+ *          use(AESD_RING_AT(&stamps, idx));
+ *
+ *  Elements are stored by value, so small records are packed back to back with no
+ *  per element indirection.  The capacity is a compile time constant taken from the
+ *  array size, so the wrap below reduces to a mask when it is a power of two and to
+ *  a compare otherwise.  The index type only needs to hold capacity - 1.
+ *
+ *  Like aesd_circular_buffer, a push onto a full ring overwrites the oldest element;
+ *  callers owning resources through the elements should release
+ *  AESD_RING_FIRST() before pushing when AESD_RING_FULL() is true.  No locking is
+ *  done here.
+ */
+
+#ifndef AESD_RING_H
+#define AESD_RING_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+/*
+ * Ring definitions.
+ */
+#define AESD_RING_HEAD(name, type, capacity, idx_type)                       \
+    struct name {                                                            \
+        type     rh_entry[capacity]; /* elements, oldest at rh_out */        \
+        idx_type rh_in;              /* next slot written */                 \
+        idx_type rh_out;             /* oldest element */                    \
+        bool     rh_full;            /* rh_in == rh_out means full */        \
+    }
+
+#define AESD_RING_HEAD_INITIALIZER(head) { .rh_in = 0, .rh_out = 0, .rh_full = false }
+
+/*
+ * Ring index arithmetic.  pos is any value below twice the capacity.
+ */
+#define AESD_RING_CAPACITY(head)                                             \
+    (sizeof((head)->rh_entry) / sizeof((head)->rh_entry[0]))
+
+#define AESD_RING_IS_POW2(head)                                              \
+    ((AESD_RING_CAPACITY(head) & (AESD_RING_CAPACITY(head) - 1)) == 0)
+
+#define AESD_RING_WRAP(head, pos)                                            \
+    (AESD_RING_IS_POW2(head) ?                                               \
+        ((size_t)(pos) & (AESD_RING_CAPACITY(head) - 1)) :                   \
+        ((size_t)(pos) >= AESD_RING_CAPACITY(head) ?                         \
+            (size_t)(pos) - AESD_RING_CAPACITY(head) : (size_t)(pos)))
+
+/*
+ * Ring functions.
+ */
+#define AESD_RING_INIT(head) do {                                            \
+    (head)->rh_in = 0;                                                       \
+    (head)->rh_out = 0;                                                      \
+    (head)->rh_full = false;                                                 \
+} while (0)
+
+#define AESD_RING_PUSH(head, elm) do {                                       \
+    (head)->rh_entry[(head)->rh_in] = (elm);                                 \
+    (head)->rh_in = AESD_RING_WRAP(head, (size_t)(head)->rh_in + 1);         \
+    if ((head)->rh_full)                                                     \
+        (head)->rh_out = (head)->rh_in;                                      \
+    else                                                                     \
+        (head)->rh_full = ((head)->rh_in == (head)->rh_out);                 \
+} while (0)
+
+#define AESD_RING_POP(head) do {                                             \
+    (head)->rh_out = AESD_RING_WRAP(head, (size_t)(head)->rh_out + 1);       \
+    (head)->rh_full = false;                                                 \
+} while (0)
+
+/*
+ * Ring access methods.  Indexes passed to AESD_RING_AT count from the oldest
+ * element and must be below AESD_RING_COUNT.
+ */
+#define AESD_RING_EMPTY(head) (!(head)->rh_full && (head)->rh_in == (head)->rh_out)
+#define AESD_RING_FULL(head) ((head)->rh_full)
+
+#define AESD_RING_COUNT(head)                                                \
+    ((head)->rh_full ? AESD_RING_CAPACITY(head) :                            \
+        AESD_RING_WRAP(head, (size_t)(head)->rh_in +                         \
+                             AESD_RING_CAPACITY(head) - (head)->rh_out))
+
+#define AESD_RING_AT(head, n)                                                \
+    (&(head)->rh_entry[AESD_RING_WRAP(head, (size_t)(head)->rh_out + (n))])
+
+#define AESD_RING_FIRST(head) (&(head)->rh_entry[(head)->rh_out])
+
+#define AESD_RING_LAST(head)                                                 \
+    (&(head)->rh_entry[AESD_RING_WRAP(head,                                  \
+        (size_t)(head)->rh_in + AESD_RING_CAPACITY(head) - 1)])
+
+#define AESD_RING_FOREACH(idx, head)                                         \
+    for ((idx) = 0; (idx) < AESD_RING_COUNT(head); (idx)++)
+
+#endif /* AESD_RING_H */
@@ -33,14 +33,96 @@ struct aesd_seekto {
     uint32_t write_cmd_offset;
 };
 
+/**
+ * A structure to be passed by IOCTL to copy out a run of whole entries, oldest first,
+ * together with their lengths and sequence numbers.  Pointers are user space addresses
+ * stored in 64 bit fields so the layout is the same for 32 and 64 bit callers.
+ */
+struct aesd_batch_read {
+    /**
+     * First entry to copy out, a zero referenced index into the entries currently held
+     * or, with AESD_BATCH_READ_BY_SEQ set in flags, a sequence number.  Sequence numbers
+     * older than the oldest entry held start the batch at the oldest entry.
+     */
+    uint64_t start;
+    /**
+     * AESD_BATCH_READ_* flags
+     */
+    uint32_t flags;
+    /**
+     * Number of members available in the lengths and seqs arrays
+     */
+    uint32_t max_entries;
+    /**
+     * uint32_t array receiving the size of each entry copied
+     */
+    uint64_t lengths;
+    /**
+     * uint64_t array receiving the sequence number of each entry copied, or 0 to skip
+     */
+    uint64_t seqs;
+    /**
+     * Buffer receiving the entry payloads packed back to back
+     */
+    uint64_t payload;
+    /**
+     * In: size of the payload buffer.  Out: number of payload bytes copied
+     */
+    uint64_t payload_size;
+    /**
+     * Out: number of entries copied.  Entries are never split, so a batch stops at the
+     * first entry that does not fit in what is left of the payload buffer
+     */
+    uint32_t count;
+    uint32_t reserved;
+    /**
+     * Out: sequence number to pass as start (with AESD_BATCH_READ_BY_SEQ) to continue
+     */
+    uint64_t next_seq;
+};
+
+#define AESD_BATCH_READ_BY_SEQ 0x1
+
+/**
+ * Device counters returned by AESDCHAR_IOCGSTATS
+ */
+struct aesd_stats {
+    uint64_t writes;
+    uint64_t reads;
+    uint64_t bytes_written;
+    uint64_t bytes_read;
+    /**
+     * Entries committed to the buffer since the driver was loaded
+     */
+    uint64_t commits;
+    /**
+     * Entries dropped to make room for newer ones
+     */
+    uint64_t evictions;
+    uint64_t entries_held;
+    uint64_t bytes_held;
+    /**
+     * Times the buffer lock was already held when a reader or writer wanted it
+     */
+    uint64_t lock_contended;
+    uint64_t alloc_failures;
+};
+
 // Pick an arbitrary unused value from https://github.com/torvalds/linux/blob/master/Documentation/userspace-api/ioctl/ioctl-number.rst
 #define AESD_IOC_MAGIC 0x16
 
 // Define a write command from the user point of view, use command number 1
 #define AESDCHAR_IOCSEEKTO _IOWR(AESD_IOC_MAGIC, 1, struct aesd_seekto)
+// Copy out a batch of entries with their framing, use command number 2
+#define AESDCHAR_IOCBATCHREAD _IOWR(AESD_IOC_MAGIC, 2, struct aesd_batch_read)
+// Read the device counters, use command number 3
+#define AESDCHAR_IOCGSTATS _IOR(AESD_IOC_MAGIC, 3, struct aesd_stats)
+// Set (nonzero) or clear tail mode for this open file, use command number 4
+// In tail mode reads at the end of data wait for the next entry, unless O_NONBLOCK
+#define AESDCHAR_IOCTAIL _IOW(AESD_IOC_MAGIC, 4, uint32_t)
 /**
  * The maximum number of commands supported, used for bounds checking
  */
-#define AESDCHAR_IOC_MAXNR 1
+#define AESDCHAR_IOC_MAXNR 4
 
 #endif /* AESD_IOCTL_H */
@@ -0,0 +1,62 @@
+/*
+ * aesd_mmap.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Katie Biggs
+ *
+ *  @brief Layout of the read only mapping exposed by aesd char devices when the
+ *  driver is loaded with aesd_mmap_slot_size set
+ */
+
+#ifndef AESD_MMAP_H
+#define AESD_MMAP_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+#include "aesd-circular-buffer.h"
+
+#define AESD_MMAP_MAGIC   0x61657364 // "aesd"
+#define AESD_MMAP_VERSION 1
+
+/**
+ * Offset stored for entries whose payload did not fit in a slot and so is only
+ * available through read()
+ */
+#define AESD_MMAP_NOT_MAPPED 0xffffffffU
+
+struct aesd_mmap_entry {
+    /**
+     * Byte offset of the payload from the start of the mapping
+     */
+    uint32_t offset;
+    /**
+     * Number of payload bytes
+     */
+    uint32_t size;
+};
+
+/**
+ * Occupies the first page of the mapping.  Payload slots follow at data_offset.
+ *
+ * generation is odd while the driver is updating the mapping.  Readers should
+ * load generation, copy out what they need, then load generation again and retry
+ * if it was odd or has changed.
+ */
+struct aesd_mmap_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t generation;
+    /**
+     * Number of valid members in entry, oldest first
+     */
+    uint32_t entry_count;
+    uint32_t data_offset;
+    uint32_t slot_size;
+    struct aesd_mmap_entry entry[AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED];
+};
+
+#endif /* AESD_MMAP_H */
@@ -8,22 +8,38 @@
 #ifndef AESD_CHAR_DRIVER_AESDCHAR_H_
 #define AESD_CHAR_DRIVER_AESDCHAR_H_
 
-#define AESD_DEBUG 1  //Remove comment on this line to enable debug
+//#define AESD_DEBUG 1  //Remove comment on this line to enable user space debug
 
 #undef PDEBUG             /* undef it, just in case */
-#ifdef AESD_DEBUG
-#  ifdef __KERNEL__
-     /* This one if debugging is on, and kernel space */
-#    define PDEBUG(fmt, args...) printk( KERN_DEBUG "aesdchar: " fmt, ## args)
-#  else
-     /* This one for user space */
-#    define PDEBUG(fmt, args...) fprintf(stderr, fmt, ## args)
-#  endif
+#ifdef __KERNEL__
+   /* Kernel space goes through dynamic debug, so messages cost nothing until enabled
+      at runtime with: echo 'module aesdchar +p' > /sys/kernel/debug/dynamic_debug/control */
+#  define PDEBUG(fmt, args...) pr_debug("aesdchar: " fmt, ## args)
+#elif defined(AESD_DEBUG)
+   /* This one for user space */
+#  define PDEBUG(fmt, args...) fprintf(stderr, fmt, ## args)
 #else
 #  define PDEBUG(fmt, args...) /* not debugging: nothing */
 #endif
 
+#ifndef AESD_NR_DEVS
+#define AESD_NR_DEVS 1    /* aesdchar0 through aesdchar(AESD_NR_DEVS-1) */
+#endif
+
 #include "aesd-circular-buffer.h"
+#include "aesd_mmap.h"
+
+/* Counters kept per cpu so the read and write paths never share a cache line for them */
+struct aesd_pcpu_stats
+{
+    u64 writes;
+    u64 reads;
+    u64 bytes_written;
+    u64 bytes_read;
+    u64 evictions;
+    u64 lock_contended;
+    u64 alloc_failures;
+};
 
 struct aesd_dev
 {
@@ -33,12 +49,46 @@ struct aesd_dev
     /* Circular buffer to store contents of writes */
     struct aesd_circular_buffer buffer;
 
-    /* Working buffer entry to use during write operations */
+    /* Unterminated record left behind by a released file, adopted by the next writer */
     struct aesd_buffer_entry working_entry;
 
+    /* Header page followed by one payload slot per buffer entry, NULL unless mmap is enabled */
+    struct aesd_mmap_header *mmap_area;
+
+    /* Bytes reserved for each payload slot in mmap_area */
+    size_t mmap_slot_size;
+
+    /* Readers waiting for a new entry to be committed, see AESDCHAR_IOCTAIL */
+    wait_queue_head_t read_queue;
+
+    /* Global sequence number given to the next committed entry, which is also the
+       number of entries committed so far.  Lets waiters tell a new commit apart */
+    u64 commit_seq;
+
+    /* Total payload bytes held in buffer, only changed with buf_mutex held */
+    size_t bytes_held;
+
+    /* Per cpu counters summed up by AESDCHAR_IOCGSTATS and debugfs */
+    struct aesd_pcpu_stats __percpu *stats;
+
     /* Char device structure */
     struct cdev cdev;
 };
 
+/* Per open file state, stored in filp->private_data */
+struct aesd_file
+{
+    /* Device this file was opened on */
+    struct aesd_dev *dev;
+
+    /* Serializes writers sharing this open file */
+    struct mutex stage_mutex;
+
+    /* Partial record staged by this file until its newline arrives */
+    struct aesd_buffer_entry working_entry;
+
+    /* Reads at the end of data wait for the next commit, set by AESDCHAR_IOCTAIL */
+    bool tail;
+};
 
 #endif /* AESD_CHAR_DRIVER_AESDCHAR_H_ */
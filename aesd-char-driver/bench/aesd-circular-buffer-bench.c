@@ -0,0 +1,314 @@
+/**
+ * @file aesd-circular-buffer-bench.c
+ * @brief Userspace microbenchmark for the aesd circular buffer
+ *
+ * Builds against the same aesd-circular-buffer.c used by the driver and reports
+ * ns/op for add_entry, sequential and random find_entry_offset_for_fpos lookups,
+ * and lookups contending with a writer for the buffer lock.  Results are printed
+ * as a single JSON object so runs can be collected and compared over time.
+ *
+ * The capacity under test is AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, so build
+ * one binary per capacity (see Makefile).
+ *
+ * @author Katie Biggs
+ * @date 2026-10-19
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../aesd-circular-buffer.h"
+#include "../aesd-ring.h"
+
+static const size_t entry_sizes[] = { 16, 256, 4096 };
+
+static volatile uintptr_t sink;
+
+/* The same entries held by value in a ring specialized for this capacity */
+AESD_RING_HEAD(bench_entry_ring, struct aesd_buffer_entry, AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, uint8_t);
+
+struct bench_result {
+    const char *name;
+    size_t      entry_size;
+    uint64_t    ops;
+    double      ns_per_op;
+};
+
+struct contention_args {
+    struct aesd_circular_buffer *buffer;
+    pthread_mutex_t *lock;
+    volatile bool   *stop;
+    size_t           total_size;
+    uint64_t         ops;
+    uint32_t         seed;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* xorshift32, cheap enough not to dominate the lookups it drives */
+static uint32_t next_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Fill the buffer with entries of entry_size bytes, all sharing one payload */
+static size_t fill_buffer(struct aesd_circular_buffer *buffer, const char *payload, size_t entry_size)
+{
+    struct aesd_buffer_entry entry = { .buffptr = payload, .size = entry_size };
+    size_t idx;
+
+    aesd_circular_buffer_init(buffer);
+    for (idx = 0; idx < AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED; idx++)
+    {
+        aesd_circular_buffer_add_entry(buffer, &entry);
+    }
+    return entry_size * AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+}
+
+static void bench_add_entry(struct bench_result *result, const char *payload, size_t entry_size, uint64_t iterations)
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry entry = { .buffptr = payload, .size = entry_size };
+    uint64_t start, idx;
+
+    aesd_circular_buffer_init(&buffer);
+    start = now_ns();
+    for (idx = 0; idx < iterations; idx++)
+    {
+        sink += (uintptr_t)aesd_circular_buffer_add_entry(&buffer, &entry);
+    }
+    result->name = "add_entry";
+    result->entry_size = entry_size;
+    result->ops = iterations;
+    result->ns_per_op = (double)(now_ns() - start) / iterations;
+}
+
+/* add_entry equivalent through the generated ring, returning the overwritten buffer the same way */
+static void bench_ring_push(struct bench_result *result, const char *payload, size_t entry_size, uint64_t iterations)
+{
+    struct bench_entry_ring ring;
+    struct aesd_buffer_entry entry = { .buffptr = payload, .size = entry_size };
+    uint64_t start, idx;
+
+    AESD_RING_INIT(&ring);
+    start = now_ns();
+    for (idx = 0; idx < iterations; idx++)
+    {
+        if (AESD_RING_FULL(&ring))
+        {
+            sink += (uintptr_t)AESD_RING_FIRST(&ring)->buffptr;
+        }
+        AESD_RING_PUSH(&ring, entry);
+    }
+    sink += AESD_RING_COUNT(&ring);
+    result->name = "ring_push";
+    result->entry_size = entry_size;
+    result->ops = iterations;
+    result->ns_per_op = (double)(now_ns() - start) / iterations;
+}
+
+static void bench_find_sequential(struct bench_result *result, const char *payload, size_t entry_size, uint64_t iterations)
+{
+    struct aesd_circular_buffer buffer;
+    size_t total_size = fill_buffer(&buffer, payload, entry_size);
+    size_t entry_offset = 0;
+    size_t fpos = 0;
+    uint64_t start, idx;
+
+    // walk the whole buffer an entry at a time, like a reader draining it
+    start = now_ns();
+    for (idx = 0; idx < iterations; idx++)
+    {
+        sink += (uintptr_t)aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, fpos, &entry_offset);
+        fpos += entry_size;
+        if (fpos >= total_size)
+        {
+            fpos = 0;
+        }
+    }
+    result->name = "find_sequential";
+    result->entry_size = entry_size;
+    result->ops = iterations;
+    result->ns_per_op = (double)(now_ns() - start) / iterations;
+}
+
+static void bench_find_random(struct bench_result *result, const char *payload, size_t entry_size, uint64_t iterations)
+{
+    struct aesd_circular_buffer buffer;
+    size_t total_size = fill_buffer(&buffer, payload, entry_size);
+    size_t entry_offset = 0;
+    uint32_t seed = 0x2545f491;
+    uint64_t start, idx;
+
+    start = now_ns();
+    for (idx = 0; idx < iterations; idx++)
+    {
+        size_t fpos = next_rand(&seed) % total_size;
+
+        sink += (uintptr_t)aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, fpos, &entry_offset);
+    }
+    result->name = "find_random";
+    result->entry_size = entry_size;
+    result->ops = iterations;
+    result->ns_per_op = (double)(now_ns() - start) / iterations;
+}
+
+static void *contention_reader(void *arg)
+{
+    struct contention_args *args = arg;
+    size_t entry_offset = 0;
+
+    while (!*args->stop)
+    {
+        size_t fpos = next_rand(&args->seed) % args->total_size;
+
+        pthread_mutex_lock(args->lock);
+        sink += (uintptr_t)aesd_circular_buffer_find_entry_offset_for_fpos(args->buffer, fpos, &entry_offset);
+        pthread_mutex_unlock(args->lock);
+        args->ops++;
+    }
+    return NULL;
+}
+
+/* One writer adding entries while reader_count threads do random lookups, all under one
+   mutex the way the driver serializes access.  Reports the writer's ns/op. */
+static void bench_contention(struct bench_result *result, const char *payload, size_t entry_size,
+                             uint64_t iterations, int reader_count)
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry entry = { .buffptr = payload, .size = entry_size };
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    volatile bool stop = false;
+    pthread_t *threads = calloc(reader_count, sizeof(pthread_t));
+    struct contention_args *args = calloc(reader_count, sizeof(struct contention_args));
+    size_t total_size = fill_buffer(&buffer, payload, entry_size);
+    int started = 0;
+    uint64_t start, idx;
+
+    result->name = "contended_add_entry";
+    result->entry_size = entry_size;
+    result->ops = 0;
+    result->ns_per_op = 0;
+    if (!threads || !args)
+    {
+        free(threads);
+        free(args);
+        return;
+    }
+
+    for (started = 0; started < reader_count; started++)
+    {
+        args[started].buffer = &buffer;
+        args[started].lock = &lock;
+        args[started].stop = &stop;
+        args[started].total_size = total_size;
+        args[started].seed = 0x9e3779b9 + started;
+        if (pthread_create(&threads[started], NULL, contention_reader, &args[started]) != 0)
+        {
+            break;
+        }
+    }
+
+    start = now_ns();
+    for (idx = 0; idx < iterations; idx++)
+    {
+        pthread_mutex_lock(&lock);
+        sink += (uintptr_t)aesd_circular_buffer_add_entry(&buffer, &entry);
+        pthread_mutex_unlock(&lock);
+    }
+    result->ops = iterations;
+    result->ns_per_op = (double)(now_ns() - start) / iterations;
+
+    stop = true;
+    while (--started >= 0)
+    {
+        pthread_join(threads[started], NULL);
+    }
+    free(threads);
+    free(args);
+}
+
+static void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n iterations] [-r reader threads]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t iterations = 1000000;
+    int reader_count = 2;
+    struct bench_result results[5 * sizeof(entry_sizes) / sizeof(entry_sizes[0])];
+    size_t result_count = 0;
+    size_t idx;
+    char *payload;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            iterations = strtoull(optarg, NULL, 10);
+            break;
+        case 'r':
+            reader_count = atoi(optarg);
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if ((iterations == 0) || (reader_count < 0))
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    payload = calloc(1, entry_sizes[sizeof(entry_sizes) / sizeof(entry_sizes[0]) - 1]);
+    if (!payload)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (idx = 0; idx < sizeof(entry_sizes) / sizeof(entry_sizes[0]); idx++)
+    {
+        bench_add_entry(&results[result_count++], payload, entry_sizes[idx], iterations);
+        bench_ring_push(&results[result_count++], payload, entry_sizes[idx], iterations);
+        bench_find_sequential(&results[result_count++], payload, entry_sizes[idx], iterations);
+        bench_find_random(&results[result_count++], payload, entry_sizes[idx], iterations);
+        bench_contention(&results[result_count++], payload, entry_sizes[idx], iterations, reader_count);
+    }
+
+    printf("{\"benchmark\":\"aesd-circular-buffer\",\"capacity\":%d,\"iterations\":%llu,\"readers\":%d,\"results\":[",
+           AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, (unsigned long long)iterations, reader_count);
+    for (idx = 0; idx < result_count; idx++)
+    {
+        printf("%s{\"name\":\"%s\",\"entry_size\":%zu,\"ops\":%llu,\"ns_per_op\":%.2f}",
+               idx ? "," : "", results[idx].name, results[idx].entry_size,
+               (unsigned long long)results[idx].ops, results[idx].ns_per_op);
+    }
+    printf("]}\n");
+
+    free(payload);
+    return EXIT_SUCCESS;
+}
@@ -18,33 +18,152 @@
 #include <linux/cdev.h>
 #include <linux/fs.h> // file_operations
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "aesdchar.h"
 #include "aesd_ioctl.h"
+#include "aesd-entry-pool.h"
+#include "aesd-delim.h"
 int aesd_major =   0; // use dynamic major
 int aesd_minor =   0;
+int aesd_nr_devs = AESD_NR_DEVS;
+
+module_param(aesd_nr_devs, int, S_IRUGO);
+MODULE_PARM_DESC(aesd_nr_devs, "Number of aesdchar devices, each with its own buffer and lock");
+
+int aesd_mmap_slot_size = 0; // 0 keeps payloads in the entry pool and disables mmap
+
+module_param(aesd_mmap_slot_size, int, S_IRUGO);
+MODULE_PARM_DESC(aesd_mmap_slot_size, "Bytes per entry of page backed storage exposed through mmap (0 disables)");
 
 MODULE_AUTHOR("Katie Biggs");
 MODULE_LICENSE("Dual BSD/GPL");
 
-struct aesd_dev aesd_device;
+struct aesd_dev *aesd_devices; // allocated in aesd_init_module
 
-int aesd_open(struct inode *inode, struct file *filp)
+// Most bytes of a write copied in and split into records at a time
+#define AESD_WRITE_CHUNK_BYTES (16 * PAGE_SIZE)
+
+static struct dentry *aesd_debugfs_root;
+
+/* Bump a per cpu counter, cheap enough for every read and write */
+#define AESD_STAT_ADD(dev, field, val) this_cpu_add((dev)->stats->field, (val))
+#define AESD_STAT_INC(dev, field)      AESD_STAT_ADD(dev, field, 1)
+
+/**
+ * @return the device behind an open aesdchar file, or NULL if private_data isn't set up
+ */
+static inline struct aesd_dev *aesd_file_dev(struct file *filp)
 {
-    PDEBUG("open");
-    filp->private_data = container_of(inode->i_cdev, struct aesd_dev, cdev);
-    return 0;
+    struct aesd_file *aesd_file = filp->private_data;
+
+    return aesd_file ? aesd_file->dev : NULL;
 }
 
-int aesd_release(struct inode *inode, struct file *filp)
+/**
+ * @return true if reads on @param filp wait at the end of data for the next commit,
+ * set per open file with AESDCHAR_IOCTAIL
+ */
+static inline bool aesd_file_tail(struct file *filp)
 {
-    PDEBUG("release");
-    return 0;
+    struct aesd_file *aesd_file = filp->private_data;
+
+    return READ_ONCE(aesd_file->tail);
+}
+
+/**
+ * Lock buf_mutex, counting the attempts that found it already held
+ * @return 0 or -EINTR as mutex_lock_interruptible
+ */
+static int aesd_dev_lock_interruptible(struct aesd_dev *aesd_dev)
+{
+    if (mutex_trylock(&aesd_dev->buf_mutex))
+    {
+        return 0;
+    }
+    AESD_STAT_INC(aesd_dev, lock_contended);
+    return mutex_lock_interruptible(&aesd_dev->buf_mutex);
+}
+
+/**
+ * Lock buf_mutex for short critical sections that must not be interrupted,
+ * counting the attempts that found it already held
+ */
+static void aesd_dev_lock(struct aesd_dev *aesd_dev)
+{
+    if (mutex_trylock(&aesd_dev->buf_mutex))
+    {
+        return;
+    }
+    AESD_STAT_INC(aesd_dev, lock_contended);
+    mutex_lock(&aesd_dev->buf_mutex);
+}
+
+/**
+ * Fill @param stats by summing the per cpu counters of @param aesd_dev
+ */
+static void aesd_dev_stats(struct aesd_dev *aesd_dev, struct aesd_stats *stats)
+{
+    int cpu;
+
+    memset(stats, 0, sizeof(*stats));
+    for_each_possible_cpu(cpu)
+    {
+        const struct aesd_pcpu_stats *pcpu = per_cpu_ptr(aesd_dev->stats, cpu);
+
+        stats->writes         += pcpu->writes;
+        stats->reads          += pcpu->reads;
+        stats->bytes_written  += pcpu->bytes_written;
+        stats->bytes_read     += pcpu->bytes_read;
+        stats->evictions      += pcpu->evictions;
+        stats->lock_contended += pcpu->lock_contended;
+        stats->alloc_failures += pcpu->alloc_failures;
+    }
+    stats->bytes_held = READ_ONCE(aesd_dev->bytes_held);
+    stats->entries_held = aesd_circular_buffer_entry_count(&aesd_dev->buffer);
+    stats->commits = READ_ONCE(aesd_dev->commit_seq);
+}
+
+/**
+ * Find the entry holding absolute position @param f_pos.  Positions that have already been
+ * evicted skip ahead to the oldest data still held, updating @param f_pos to match.
+ * Must be called with buf_mutex held.
+ * @return the entry, with the offset into it in @param entry_offset, or NULL at end of data
+ */
+static struct aesd_buffer_entry *aesd_dev_find_entry(struct aesd_dev *aesd_dev, loff_t *f_pos,
+                                                     size_t *entry_offset)
+{
+    struct aesd_circular_buffer *buffer = &aesd_dev->buffer;
+
+    if (*f_pos < 0)
+    {
+        return NULL;
+    }
+    if ((uint64_t)*f_pos < buffer->out_fpos)
+    {
+        PDEBUG("position %lld was evicted, skipping to %llu", *f_pos, buffer->out_fpos);
+        *f_pos = buffer->out_fpos;
+    }
+    if ((uint64_t)*f_pos >= buffer->in_fpos)
+    {
+        return NULL;
+    }
+
+    return aesd_circular_buffer_find_entry_offset_for_fpos(buffer, *f_pos - buffer->out_fpos,
+                                                           entry_offset);
 }
 
 ssize_t aesd_read(struct file *filp, char __user *buf, size_t count,
                 loff_t *f_pos)
 {
-    ssize_t ret_offset = 0;
+    size_t ret_offset = 0;
     ssize_t bytes_to_read_out = 0;
     struct aesd_buffer_entry *ret_entry = NULL;
     struct aesd_dev *aesd_dev = NULL;
@@ -58,7 +177,7 @@ ssize_t aesd_read(struct file *filp, char __user *buf, size_t count,
     }
 
     // use filp private_data to get aesd_dev
-    aesd_dev = filp->private_data;
+    aesd_dev = aesd_file_dev(filp);
 
     if (!aesd_dev)
     {
@@ -67,15 +186,41 @@ ssize_t aesd_read(struct file *filp, char __user *buf, size_t count,
     }
 
     // lock mutex before reading from circular buffer
-    if (mutex_lock_interruptible(&aesd_dev->buf_mutex))
+    if (aesd_dev_lock_interruptible(aesd_dev))
     {
         PDEBUG("Unable to lock mutex for read");
         return -ERESTARTSYS;
     }
 
-    // start read at fpos
+    // start read at fpos, an absolute position that stays valid as the buffer wraps
     // ret_offset gets the location within a single entry (the returned entry) corresponding to f_pos
-    ret_entry = aesd_circular_buffer_find_entry_offset_for_fpos(&aesd_dev->buffer, *f_pos, &ret_offset);
+    ret_entry = aesd_dev_find_entry(aesd_dev, f_pos, &ret_offset);
+
+    // in tail mode, wait for the next commit instead of reporting end of file
+    while (!ret_entry && aesd_file_tail(filp))
+    {
+        u64 commit_seq = aesd_dev->commit_seq;
+
+        mutex_unlock(&aesd_dev->buf_mutex);
+
+        if (filp->f_flags & O_NONBLOCK)
+        {
+            return -EAGAIN;
+        }
+
+        if (wait_event_interruptible(aesd_dev->read_queue,
+                                     READ_ONCE(aesd_dev->commit_seq) != commit_seq))
+        {
+            return -ERESTARTSYS;
+        }
+
+        if (aesd_dev_lock_interruptible(aesd_dev))
+        {
+            PDEBUG("Unable to lock mutex for read");
+            return -ERESTARTSYS;
+        }
+        ret_entry = aesd_dev_find_entry(aesd_dev, f_pos, &ret_offset);
+    }
 
     // if entry is still null, then we weren't able to read anything at f_pos
     // so we must be at end of file
@@ -109,19 +254,496 @@ ssize_t aesd_read(struct file *filp, char __user *buf, size_t count,
 
     // move f_pos forward according to the number of bytes we've read
     *f_pos = *f_pos + bytes_to_read_out;
+    AESD_STAT_INC(aesd_dev, reads);
+    AESD_STAT_ADD(aesd_dev, bytes_read, bytes_to_read_out);
 
     // unlock mutex & return the number of bytes read out
     mutex_unlock(&aesd_dev->buf_mutex);
     return bytes_to_read_out;
 }
 
+/**
+ * @return true if @param buffptr is a payload slot in the mmap area rather than a pool buffer
+ */
+static bool aesd_mmap_owns(struct aesd_dev *aesd_dev, const char *buffptr)
+{
+    const char *area = (const char *)aesd_dev->mmap_area;
+
+    return area && (buffptr >= area) &&
+           (buffptr < area + PAGE_SIZE + AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED * aesd_dev->mmap_slot_size);
+}
+
+/**
+ * Hand the payload of a dropped entry back to wherever it came from
+ */
+static void aesd_entry_release(struct aesd_dev *aesd_dev, const char *buffptr, size_t size)
+{
+    if (!aesd_mmap_owns(aesd_dev, buffptr))
+    {
+        aesd_entry_pool_free(buffptr, size);
+    }
+}
+
+/**
+ * Rewrite the mmap header entry table from the circular buffer, oldest entry first,
+ * and close the update started by bumping the generation to an odd value.
+ * Must be called with buf_mutex held.
+ */
+static void aesd_mmap_publish(struct aesd_dev *aesd_dev)
+{
+    struct aesd_mmap_header *hdr = aesd_dev->mmap_area;
+    struct aesd_circular_buffer *buffer = &aesd_dev->buffer;
+    uint32_t count = 0;
+    uint8_t idx = buffer->out_offs;
+
+    if (buffer->full || (buffer->in_offs != buffer->out_offs))
+    {
+        do
+        {
+            const char *buffptr = buffer->entry[idx].buffptr;
+
+            hdr->entry[count].size = buffer->entry[idx].size;
+            hdr->entry[count].offset = aesd_mmap_owns(aesd_dev, buffptr) ?
+                                       (uint32_t)(buffptr - (const char *)hdr) : AESD_MMAP_NOT_MAPPED;
+            count++;
+
+            idx++;
+            idx %= AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+        } while (idx != buffer->in_offs);
+    }
+    hdr->entry_count = count;
+
+    smp_wmb();
+    WRITE_ONCE(hdr->generation, hdr->generation + 1);
+}
+
+/**
+ * Add a completed record of @param size bytes stored at @param buffptr, a pool buffer or
+ * the mmap slot for the current buffer index, to the circular buffer, handing any entry it
+ * overwrites back to where it came from.
+ * With mmap enabled the caller brackets this with an odd generation and aesd_mmap_publish().
+ * Must be called with buf_mutex held.
+ */
+static void aesd_commit_entry(struct aesd_dev *aesd_dev, const char *buffptr, size_t size)
+{
+    struct aesd_buffer_entry new_entry = {0};
+    struct aesd_buffer_entry old_entry = {0};
+    const char *ret_buf = NULL;
+
+    new_entry.buffptr = buffptr;
+    new_entry.size    = size;
+
+    // more than 10 writes should free the oldest
+    // save off the size of the entry about to be overwritten since the pool needs it
+    if (aesd_dev->buffer.full)
+    {
+        old_entry = aesd_dev->buffer.entry[aesd_dev->buffer.in_offs];
+    }
+
+    // if the add entry has returned non-null, hand it back
+    ret_buf = aesd_circular_buffer_add_entry(&aesd_dev->buffer, &new_entry);
+    if (ret_buf)
+    {
+        aesd_entry_release(aesd_dev, ret_buf, old_entry.size);
+        AESD_STAT_INC(aesd_dev, evictions);
+    }
+    aesd_dev->bytes_held += size - old_entry.size;
+
+    // let pollers and tail readers know there is something new to read
+    WRITE_ONCE(aesd_dev->commit_seq, aesd_dev->commit_seq + 1);
+    wake_up_interruptible_poll(&aesd_dev->read_queue, EPOLLIN | EPOLLRDNORM);
+}
+
+/**
+ * Start an update of the mmap area, if there is one, by bumping the generation to an odd
+ * value so mappers know entries are changing underneath them.  Closed by aesd_mmap_publish().
+ * Must be called with buf_mutex held.
+ */
+static void aesd_mmap_begin(struct aesd_dev *aesd_dev)
+{
+    struct aesd_mmap_header *hdr = aesd_dev->mmap_area;
+
+    if (hdr)
+    {
+        WRITE_ONCE(hdr->generation, hdr->generation + 1);
+        smp_wmb();
+    }
+}
+
+/**
+ * Copy @param size bytes at @param src into a new pool buffer, after the @param prefix_size
+ * bytes at @param prefix.
+ * @return the new buffer or NULL on allocation failure
+ */
+static char *aesd_entry_dup(const char *prefix, size_t prefix_size, const char *src, size_t size)
+{
+    char *entry_buf = aesd_entry_pool_alloc(prefix_size + size, GFP_KERNEL);
+
+    if (entry_buf)
+    {
+        if (prefix_size)
+        {
+            memcpy(entry_buf, prefix, prefix_size);
+        }
+        memcpy(entry_buf + prefix_size, src, size);
+    }
+    return entry_buf;
+}
+
+int aesd_open(struct inode *inode, struct file *filp)
+{
+    struct aesd_file *aesd_file = NULL;
+
+    PDEBUG("open");
+
+    aesd_file = kzalloc(sizeof(struct aesd_file), GFP_KERNEL);
+    if (!aesd_file)
+    {
+        return -ENOMEM;
+    }
+
+    aesd_file->dev = container_of(inode->i_cdev, struct aesd_dev, cdev);
+    mutex_init(&aesd_file->stage_mutex);
+    filp->private_data = aesd_file;
+    return 0;
+}
+
+int aesd_release(struct inode *inode, struct file *filp)
+{
+    struct aesd_file *aesd_file = filp->private_data;
+    struct aesd_dev *aesd_dev = NULL;
+    struct aesd_buffer_entry *orphan = NULL;
+
+    PDEBUG("release");
+
+    if (!aesd_file)
+    {
+        return 0;
+    }
+
+    // hand an unterminated record over to the device, so the next writer to start a
+    // record picks it up just like partial writes from separate opens always did
+    aesd_dev = aesd_file->dev;
+    if (aesd_file->working_entry.size)
+    {
+        aesd_dev_lock(aesd_dev);
+        orphan = &aesd_dev->working_entry;
+        if (!orphan->size)
+        {
+            *orphan = aesd_file->working_entry;
+            aesd_file->working_entry.buffptr = NULL;
+        }
+        else
+        {
+            char *merged = aesd_entry_dup(orphan->buffptr, orphan->size,
+                                          aesd_file->working_entry.buffptr, aesd_file->working_entry.size);
+            if (merged)
+            {
+                aesd_entry_pool_free(orphan->buffptr, orphan->size);
+                orphan->buffptr = merged;
+                orphan->size += aesd_file->working_entry.size;
+            }
+            else
+            {
+                PDEBUG("Unable to merge partial record on release, dropping it");
+                AESD_STAT_INC(aesd_dev, alloc_failures);
+            }
+        }
+        mutex_unlock(&aesd_dev->buf_mutex);
+    }
+
+    aesd_entry_pool_free(aesd_file->working_entry.buffptr, aesd_file->working_entry.size);
+    mutex_destroy(&aesd_file->stage_mutex);
+    kfree(aesd_file);
+    return 0;
+}
+
+/**
+ * A completed record waiting to be committed
+ */
+struct aesd_write_record
+{
+    /* Pool buffer holding the record, or NULL to copy it from data when committed */
+    char *buf;
+    /* Record contents inside a chunk staged by the current write, when buf is NULL */
+    const char *data;
+    size_t size;
+    /* Bytes of the current write the record holds, the rest came from earlier writes */
+    size_t bytes;
+};
+
+/**
+ * Complete records waiting to be committed together, in write order
+ */
+struct aesd_write_batch
+{
+    struct aesd_write_record record[AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED];
+    size_t count;
+};
+
+/**
+ * @return true if a record of @param size bytes is kept in an mmap slot rather than the pool
+ */
+static bool aesd_write_fits_slot(struct aesd_dev *aesd_dev, size_t size)
+{
+    return aesd_dev->mmap_area && (size <= aesd_dev->mmap_slot_size);
+}
+
+/**
+ * Commit the records queued on @param batch in one short critical section.  Records still
+ * pointing into a staged chunk are copied into a pool buffer first, without the lock, unless
+ * they fit an mmap slot.  Slot records are copied in under the lock, after evicting the
+ * oldest entry if the buffer is full so the slot is free.  Nothing here waits on user memory,
+ * the lock is only interruptible to honour signals while other users hold it.
+ * @param consumed advanced by the bytes of the current write that were committed
+ * @return 0, or -ENOMEM or -ERESTARTSYS with the records that could not be committed dropped
+ */
+static int aesd_write_batch_flush(struct aesd_dev *aesd_dev, struct aesd_write_batch *batch,
+                                  size_t *consumed)
+{
+    struct aesd_buffer_entry old_entry = {0};
+    size_t count = batch->count;
+    size_t idx;
+    int retval = 0;
+
+    for (idx = 0; idx < count; idx++)
+    {
+        struct aesd_write_record *record = &batch->record[idx];
+
+        if (record->buf || aesd_write_fits_slot(aesd_dev, record->size))
+        {
+            continue;
+        }
+        record->buf = aesd_entry_pool_alloc(record->size, GFP_KERNEL);
+        if (!record->buf)
+        {
+            PDEBUG("Unable to allocate for the new write command addition");
+            AESD_STAT_INC(aesd_dev, alloc_failures);
+            retval = -ENOMEM;
+            count = idx;
+            break;
+        }
+        memcpy(record->buf, record->data, record->size);
+    }
+
+    if (count && aesd_dev_lock_interruptible(aesd_dev))
+    {
+        PDEBUG("Unable to lock mutex for write");
+        retval = -ERESTARTSYS;
+        count = 0;
+    }
+
+    if (count)
+    {
+        aesd_mmap_begin(aesd_dev);
+        for (idx = 0; idx < count; idx++)
+        {
+            struct aesd_write_record *record = &batch->record[idx];
+            const char *buffptr = record->buf;
+
+            if (aesd_write_fits_slot(aesd_dev, record->size))
+            {
+                char *slot = NULL;
+
+                if (aesd_dev->buffer.full && aesd_circular_buffer_remove_entry(&aesd_dev->buffer, &old_entry))
+                {
+                    aesd_entry_release(aesd_dev, old_entry.buffptr, old_entry.size);
+                    aesd_dev->bytes_held -= old_entry.size;
+                    AESD_STAT_INC(aesd_dev, evictions);
+                }
+                slot = (char *)aesd_dev->mmap_area + PAGE_SIZE + aesd_dev->buffer.in_offs * aesd_dev->mmap_slot_size;
+                memcpy(slot, record->buf ? record->buf : record->data, record->size);
+                aesd_entry_pool_free(record->buf, record->size);
+                buffptr = slot;
+            }
+            aesd_commit_entry(aesd_dev, buffptr, record->size);
+            *consumed += record->bytes;
+        }
+        if (aesd_dev->mmap_area)
+        {
+            aesd_mmap_publish(aesd_dev);
+        }
+        mutex_unlock(&aesd_dev->buf_mutex);
+    }
+
+    // whatever did not make it in is dropped, the write reports only what was committed
+    for (idx = count; idx < batch->count; idx++)
+    {
+        aesd_entry_pool_free(batch->record[idx].buf, batch->record[idx].size);
+    }
+    batch->count = 0;
+    return retval;
+}
+
+/**
+ * Queue a completed record on @param batch, committing the batch first if it is full.
+ * @param buf pool buffer holding the record, or NULL to copy it from @param data later
+ * @param bytes how many of the record's @param size bytes came from the current write
+ * @return 0, or the error from committing the full batch, in which case the record is
+ * not queued and @param buf still belongs to the caller
+ */
+static int aesd_write_batch_add(struct aesd_dev *aesd_dev, struct aesd_write_batch *batch,
+                                char *buf, const char *data, size_t size, size_t bytes,
+                                size_t *consumed)
+{
+    struct aesd_write_record *record = NULL;
+    int retval = 0;
+
+    // hand completed records to the device in batches to keep the lock hold short
+    if (batch->count == ARRAY_SIZE(batch->record))
+    {
+        retval = aesd_write_batch_flush(aesd_dev, batch, consumed);
+        if (retval)
+        {
+            return retval;
+        }
+    }
+    record = &batch->record[batch->count++];
+    record->buf = buf;
+    record->data = data;
+    record->size = size;
+    record->bytes = bytes;
+    return 0;
+}
+
+/**
+ * Append @param size bytes of user memory at @param src to the partial record staged in
+ * @param working_entry, copying them straight into its final storage.
+ * @return 0, or -ENOMEM or -EFAULT with @param working_entry untouched
+ */
+static int aesd_write_stage(struct aesd_dev *aesd_dev, struct aesd_buffer_entry *working_entry,
+                            const char __user *src, size_t size)
+{
+    char *working_buf = (char *)working_entry->buffptr;
+    char *new_buf = NULL;
+    size_t new_size = working_entry->size + size;
+
+    // the pool hands out power of two size classes, so repeated partial writes grow geometrically
+    if (!working_buf || (aesd_entry_pool_capacity(working_entry->size) < new_size))
+    {
+        new_buf = aesd_entry_pool_alloc(new_size, GFP_KERNEL);
+        if (!new_buf)
+        {
+            PDEBUG("Unable to allocate for the new write command addition");
+            AESD_STAT_INC(aesd_dev, alloc_failures);
+            return -ENOMEM;
+        }
+        working_buf = new_buf;
+    }
+
+    // the old contents are only carried over once this succeeds, so a fault leaves the entry untouched
+    if (copy_from_user(working_buf + working_entry->size, src, size))
+    {
+        PDEBUG("Unable to copy buffer to kernel for writing");
+        aesd_entry_pool_free(new_buf, new_size);
+        return -EFAULT;
+    }
+    if (new_buf)
+    {
+        if (working_entry->buffptr)
+        {
+            memcpy(new_buf, working_entry->buffptr, working_entry->size);
+            aesd_entry_pool_free(working_entry->buffptr, working_entry->size);
+        }
+        working_entry->buffptr = new_buf;
+    }
+    working_entry->size = new_size;
+    return 0;
+}
+
+/**
+ * Split the chunk of @param chunk_size bytes just appended to @param working_entry into
+ * records at the @param newline_count newlines found so far, whose offsets from the start
+ * of the entry are in @param newlines.  The entry's buffer becomes a staging area the records
+ * are copied out of when committed, and only the bytes after the last newline stay staged.
+ * @return 0, or a negative error with the records that were not committed dropped and the
+ * entry left empty
+ */
+static int aesd_write_split(struct aesd_dev *aesd_dev, struct aesd_write_batch *batch,
+                            struct aesd_buffer_entry *working_entry, size_t chunk_size,
+                            size_t *newlines, size_t newline_count, size_t *consumed)
+{
+    const char *stage = working_entry->buffptr;
+    size_t stage_size = working_entry->size;
+    size_t prefix_size = stage_size - chunk_size;
+    size_t record_start = 0;
+    size_t idx = 0;
+    int retval = 0;
+
+    // the records below point into the stage, which this function now owns
+    working_entry->buffptr = NULL;
+    working_entry->size = 0;
+
+    while (newline_count)
+    {
+        for (idx = 0; idx < newline_count; idx++)
+        {
+            size_t record_end = newlines[idx] + 1;
+            size_t bytes = record_end - max(record_start, prefix_size);
+
+            retval = aesd_write_batch_add(aesd_dev, batch, NULL, stage + record_start,
+                                          record_end - record_start, bytes, consumed);
+            if (retval)
+            {
+                goto out;
+            }
+            record_start = record_end;
+        }
+
+        // a full batch of positions may stop short of the last newline
+        if (newline_count < AESD_DELIM_SCAN_BATCH)
+        {
+            break;
+        }
+        newline_count = aesd_delim_scan(stage + record_start, stage_size - record_start, '\n',
+                                        newlines, AESD_DELIM_SCAN_BATCH);
+        for (idx = 0; idx < newline_count; idx++)
+        {
+            newlines[idx] += record_start;
+        }
+    }
+
+    // the records point into the stage, so they go in before it is released
+    retval = aesd_write_batch_flush(aesd_dev, batch, consumed);
+    if (retval)
+    {
+        goto out;
+    }
+
+    // whatever follows the last newline starts the next record
+    if (record_start < stage_size)
+    {
+        char *tail = aesd_entry_pool_alloc(stage_size - record_start, GFP_KERNEL);
+
+        if (!tail)
+        {
+            PDEBUG("Unable to allocate for the new write command addition");
+            AESD_STAT_INC(aesd_dev, alloc_failures);
+            retval = -ENOMEM;
+            goto out;
+        }
+        memcpy(tail, stage + record_start, stage_size - record_start);
+        working_entry->buffptr = tail;
+        working_entry->size = stage_size - record_start;
+        *consumed += stage_size - record_start;
+    }
+
+out:
+    aesd_entry_pool_free(stage, stage_size);
+    return retval;
+}
+
 ssize_t aesd_write(struct file *filp, const char __user *buf, size_t count,
                 loff_t *f_pos)
 {
     ssize_t retval = 0;
-    ssize_t bytes_to_write = 0;
+    struct aesd_file *aesd_file = NULL;
     struct aesd_dev *aesd_dev = NULL;
-    char *write_buf = NULL;
+    struct aesd_buffer_entry *working_entry = NULL;
+    struct aesd_write_batch batch = { .count = 0 };
+    size_t newlines[AESD_DELIM_SCAN_BATCH];
+    size_t newline_count = 0;
+    size_t consumed = 0;    // bytes of buf committed or staged
 
     PDEBUG("write %zu bytes with offset %lld",count,*f_pos);
 
@@ -131,17 +753,9 @@ ssize_t aesd_write(struct file *filp, const char __user *buf, size_t count,
         return -EINVAL;
     }
 
-    // allocate memory as each write command is received
-    // use kmalloc and check for errors with alloc being too big
-    write_buf = kmalloc(count, GFP_KERNEL);
-    if (!write_buf)
-    {
-        PDEBUG("Unable to allocate memory for write");
-        return -ENOMEM;
-    }
-
-    // use filp private_data to get aesd_dev
-    aesd_dev = filp->private_data;
+    // use filp private_data to get the per open staging area and aesd_dev
+    aesd_file = filp->private_data;
+    aesd_dev = aesd_file_dev(filp);
 
     if (!aesd_dev)
     {
@@ -149,84 +763,99 @@ ssize_t aesd_write(struct file *filp, const char __user *buf, size_t count,
         return -EPERM;
     }
 
-    // copy buffer from user space into kernel buffer
-    if (copy_from_user(write_buf, buf, count))
-    {
-        PDEBUG("Unable to copy buffer to kernel for writing");
-        kfree(write_buf);
-        return -EFAULT;
-    }
-    
-    // check to see if there's a newline in the input
-    char * new_line_found = memchr(write_buf, '\n', count);
-
-    if (new_line_found)
+    if (count == 0)
     {
-        bytes_to_write = 1 + (new_line_found - write_buf);
+        return 0;
     }
-    else
-    {
-        bytes_to_write = count;
-    }    
 
-    // lock mutex before writing to circular buffer
-    if (mutex_lock_interruptible(&aesd_dev->buf_mutex))
+    // partial records are staged per open file, so writers only serialize against
+    // other users of the same file until a record is complete
+    if (mutex_lock_interruptible(&aesd_file->stage_mutex))
     {
-        PDEBUG("Unable to lock mutex for read");
-        kfree(write_buf);
+        PDEBUG("Unable to lock staging mutex for write");
         return -ERESTARTSYS;
     }
 
-    // realloc working entry so that we can store the new contents to write
-    aesd_dev->working_entry.buffptr = krealloc(aesd_dev->working_entry.buffptr,
-                                               aesd_dev->working_entry.size+bytes_to_write,
-                                               GFP_KERNEL);
-    if (!aesd_dev->working_entry.buffptr)
+    working_entry = &aesd_file->working_entry;
+
+    // starting a new record, adopt whatever partial record a closed file left behind
+    if (!working_entry->size && READ_ONCE(aesd_dev->working_entry.size))
     {
-        PDEBUG("Unable to reallocate for the new write command addition");
+        aesd_dev_lock(aesd_dev);
+        *working_entry = aesd_dev->working_entry;
+        aesd_dev->working_entry.buffptr = NULL;
+        aesd_dev->working_entry.size = 0;
         mutex_unlock(&aesd_dev->buf_mutex);
-        kfree(write_buf);
-        return -ENOMEM;
     }
 
-    // copy the most recent write buffer into working entry
-    // use the working_entry.size so that we start copying at the end of the entry
-    memcpy(aesd_dev->working_entry.buffptr+aesd_dev->working_entry.size,
-           write_buf, bytes_to_write);
-
-    aesd_dev->working_entry.size += bytes_to_write;
-
-    // add into circular buffer once full packet is received    
-    if (new_line_found)
+    // user memory is read once, straight into the working entry, and the record boundaries
+    // are found in that kernel copy so a buffer changing underneath us can't split a record
+    // anywhere but at a newline
+    while ((retval == 0) && (consumed < count))
     {
-        struct aesd_buffer_entry new_entry = {0};
-        const char *ret_buf = NULL;
-        new_entry.buffptr = aesd_dev->working_entry.buffptr;
-        new_entry.size    = aesd_dev->working_entry.size;
+        size_t chunk_size = min_t(size_t, count - consumed, AESD_WRITE_CHUNK_BYTES);
+        size_t prefix_size = working_entry->size;
 
-        // more than 10 writes should free the oldest
-        // if the add entry has returned non-null, free
-        ret_buf = aesd_circular_buffer_add_entry(&aesd_dev->buffer, &new_entry);
-        if (ret_buf)
+        retval = aesd_write_stage(aesd_dev, working_entry, buf + consumed, chunk_size);
+        if (retval)
+        {
+            break;
+        }
+        newline_count = aesd_delim_scan(working_entry->buffptr + prefix_size, chunk_size, '\n',
+                                        newlines, ARRAY_SIZE(newlines));
+        if (newline_count == 0)
         {
-            kfree(ret_buf);
+            consumed += chunk_size;
+        }
+        else if ((newline_count == 1) && (newlines[0] == chunk_size - 1))
+        {
+            // one record ending the chunk is committed from where it was copied in
+            retval = aesd_write_batch_add(aesd_dev, &batch, (char *)working_entry->buffptr, NULL,
+                                          working_entry->size, chunk_size, &consumed);
+            if (retval)
+            {
+                // the chunk can't be reported as written, so it can't stay staged either
+                aesd_entry_pool_free(working_entry->buffptr, working_entry->size);
+            }
+            working_entry->buffptr = NULL;
+            working_entry->size = 0;
+        }
+        else
+        {
+            size_t idx;
+
+            for (idx = 0; idx < newline_count; idx++)
+            {
+                newlines[idx] += prefix_size;
+            }
+            retval = aesd_write_split(aesd_dev, &batch, working_entry, chunk_size,
+                                      newlines, newline_count, &consumed);
         }
 
-        aesd_dev->working_entry.size = 0;
-        aesd_dev->working_entry.buffptr = NULL;
-    }    
+        // commit before staging more, so consumed always covers a leading run of buf
+        if (retval == 0)
+        {
+            retval = aesd_write_batch_flush(aesd_dev, &batch, &consumed);
+        }
+    }
+    mutex_unlock(&aesd_file->stage_mutex);
 
-    // unlock mutex
-    mutex_unlock(&aesd_dev->buf_mutex);
-    kfree(write_buf);
+    // a failure after some records went in reports a short write covering them
+    if (consumed)
+    {
+        retval = consumed;
+    }
+    if (retval < 0)
+    {
+        return retval;
+    }
 
     // update fpos
-    *f_pos = *f_pos + count;
+    *f_pos = *f_pos + retval;
+    AESD_STAT_INC(aesd_dev, writes);
+    AESD_STAT_ADD(aesd_dev, bytes_written, retval);
 
     // return number of bytes written
-    // if nothing written, return 0
-    retval = count;
-
     return retval;
 }
 
@@ -242,7 +871,7 @@ loff_t aesd_llseek(struct file *filp, loff_t off, int whence)
     }
 
     // use filp private_data to get aesd_dev
-    aesd_dev = filp->private_data;
+    aesd_dev = aesd_file_dev(filp);
 
     if (!aesd_dev)
     {
@@ -251,23 +880,15 @@ loff_t aesd_llseek(struct file *filp, loff_t off, int whence)
     }
 
     // lock mutex before reading from circular buffer
-    if (mutex_lock_interruptible(&aesd_dev->buf_mutex))
+    if (aesd_dev_lock_interruptible(aesd_dev))
     {
         PDEBUG("Unable to lock mutex for read");
         return -ERESTARTSYS;
     }
 
-    // calculate the size of all the buffer contents
-    loff_t buf_size = 0;
-
-    int idx = 0;
-    struct aesd_buffer_entry *entry = NULL;
-    AESD_CIRCULAR_BUFFER_FOREACH(entry, &aesd_dev->buffer, idx)
-    {
-       buf_size += entry->size;
-    }
-
-    retval = fixed_size_llseek(filp, off, whence, buf_size);
+    // positions are absolute, so the end of the data is the monotonic offset past the newest entry
+    // seeking before the oldest entry is allowed, reads skip ahead to the data still held
+    retval = fixed_size_llseek(filp, off, whence, aesd_dev->buffer.in_fpos);
 
     if (retval < 0)
     {
@@ -284,10 +905,170 @@ loff_t aesd_llseek(struct file *filp, loff_t off, int whence)
     return retval;
 }
 
+static long aesd_ioctl_seekto(struct file *filp, struct aesd_dev *aesd_dev, unsigned long arg)
+{
+    struct aesd_seekto seek_to;
+
+    // copy from userspace
+    if (copy_from_user(&seek_to, (const void __user *)arg, sizeof(seek_to)))
+    {
+        return -EFAULT;
+    }
+
+    if (aesd_dev_lock_interruptible(aesd_dev))
+    {
+        PDEBUG("Unable to lock mutex for read");
+        return -ERESTARTSYS;
+    }
+
+    // bounds check the number of commands and command length
+    // write_cmd counts from the oldest entry still held
+    uint8_t entry_count = aesd_circular_buffer_entry_count(&aesd_dev->buffer);
+    uint8_t entry_idx = (aesd_dev->buffer.out_offs + seek_to.write_cmd) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+    if ((seek_to.write_cmd >= entry_count) ||
+        (seek_to.write_cmd_offset >= aesd_dev->buffer.entry[entry_idx].size))
+    {
+        mutex_unlock(&aesd_dev->buf_mutex);
+        return -EINVAL;
+    }
+
+    // update fpos (absolute starting offset of the command + write cmd offset)
+    loff_t offset = aesd_dev->buffer.entry_end[entry_idx] - aesd_dev->buffer.entry[entry_idx].size;
+
+    mutex_unlock(&aesd_dev->buf_mutex);
+    filp->f_pos = offset + seek_to.write_cmd_offset;
+    PDEBUG("updated fpos %lld",filp->f_pos);
+
+    return 0;
+}
+
+static long aesd_ioctl_batch_read(struct aesd_dev *aesd_dev, unsigned long arg)
+{
+    struct aesd_batch_read batch;
+    struct aesd_circular_buffer *buffer = &aesd_dev->buffer;
+    uint32_t __user *lengths = NULL;
+    uint64_t __user *seqs = NULL;
+    char __user *payload = NULL;
+    uint64_t payload_used = 0;
+    uint64_t first_seq = 0;
+    uint64_t seq = 0;
+    uint8_t entry_count = 0;
+    uint8_t idx = 0;
+    long retval = 0;
+
+    // copy from userspace
+    if (copy_from_user(&batch, (const void __user *)arg, sizeof(batch)))
+    {
+        return -EFAULT;
+    }
+
+    lengths = u64_to_user_ptr(batch.lengths);
+    seqs    = u64_to_user_ptr(batch.seqs);
+    payload = u64_to_user_ptr(batch.payload);
+    if (!lengths || !payload)
+    {
+        return -EINVAL;
+    }
+
+    if (aesd_dev_lock_interruptible(aesd_dev))
+    {
+        PDEBUG("Unable to lock mutex for read");
+        return -ERESTARTSYS;
+    }
+
+    // entries carry consecutive sequence numbers starting from the oldest one held
+    entry_count = aesd_circular_buffer_entry_count(buffer);
+    first_seq = buffer->out_seq;
+    if (batch.flags & AESD_BATCH_READ_BY_SEQ)
+    {
+        seq = max_t(uint64_t, batch.start, first_seq);
+    }
+    else
+    {
+        seq = first_seq + min_t(uint64_t, batch.start, entry_count);
+    }
+
+    batch.count = 0;
+    while ((seq < first_seq + entry_count) && (batch.count < batch.max_entries))
+    {
+        const struct aesd_buffer_entry *entry = NULL;
+        uint32_t size = 0;
+
+        idx = (buffer->out_offs + (seq - first_seq)) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+        entry = &buffer->entry[idx];
+        size = entry->size;
+
+        // keep framing intact, entries are never split across batches
+        if (size > batch.payload_size - payload_used)
+        {
+            if (batch.count == 0)
+            {
+                retval = -EMSGSIZE;
+            }
+            break;
+        }
+
+        if (copy_to_user(payload + payload_used, entry->buffptr, size) ||
+            put_user(size, &lengths[batch.count]) ||
+            (seqs && put_user(seq, &seqs[batch.count])))
+        {
+            retval = -EFAULT;
+            break;
+        }
+
+        payload_used += size;
+        batch.count++;
+        seq++;
+    }
+
+    mutex_unlock(&aesd_dev->buf_mutex);
+
+    if (retval)
+    {
+        return retval;
+    }
+
+    batch.payload_size = payload_used;
+    batch.next_seq = seq;
+    if (copy_to_user((void __user *)arg, &batch, sizeof(batch)))
+    {
+        return -EFAULT;
+    }
+
+    PDEBUG("batch read %u entries, %llu bytes", batch.count, payload_used);
+    return 0;
+}
+
+static long aesd_ioctl_tail(struct file *filp, unsigned long arg)
+{
+    struct aesd_file *aesd_file = filp->private_data;
+    uint32_t tail;
+
+    if (copy_from_user(&tail, (const void __user *)arg, sizeof(tail)))
+    {
+        return -EFAULT;
+    }
+
+    // only changes how this open file behaves at the end of data
+    WRITE_ONCE(aesd_file->tail, tail != 0);
+    return 0;
+}
+
+static long aesd_ioctl_get_stats(struct aesd_dev *aesd_dev, unsigned long arg)
+{
+    struct aesd_stats stats;
+
+    aesd_dev_stats(aesd_dev, &stats);
+    if (copy_to_user((void __user *)arg, &stats, sizeof(stats)))
+    {
+        return -EFAULT;
+    }
+    return 0;
+}
+
 long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
     struct aesd_dev *aesd_dev = NULL;
-    struct aesd_seekto seek_to;
     
     // check for filp being valid
     if (!filp)
@@ -296,7 +1077,7 @@ long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
     }
 
     // use filp private_data to get aesd_dev
-    aesd_dev = filp->private_data;
+    aesd_dev = aesd_file_dev(filp);
 
     if (!aesd_dev)
     {
@@ -305,44 +1086,99 @@ long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
     }
 
     // check for cmd being valid
-    if (cmd != AESDCHAR_IOCSEEKTO)
+    if ((_IOC_TYPE(cmd) != AESD_IOC_MAGIC) || (_IOC_NR(cmd) > AESDCHAR_IOC_MAXNR))
     {
         return -ENOTTY;
     }
 
-    // copy from userspace
-    if (copy_from_user(&seek_to, (const void __user *)arg, sizeof(seek_to)))
+    switch (cmd)
     {
-        return -EFAULT;
+    case AESDCHAR_IOCSEEKTO:
+        return aesd_ioctl_seekto(filp, aesd_dev, arg);
+    case AESDCHAR_IOCBATCHREAD:
+        return aesd_ioctl_batch_read(aesd_dev, arg);
+    case AESDCHAR_IOCGSTATS:
+        return aesd_ioctl_get_stats(aesd_dev, arg);
+    case AESDCHAR_IOCTAIL:
+        return aesd_ioctl_tail(filp, arg);
+    default:
+        return -ENOTTY;
     }
+}
+
+int aesd_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    struct aesd_dev *aesd_dev = NULL;
 
-    if (mutex_lock_interruptible(&aesd_dev->buf_mutex))
+    // check for filp being valid
+    if (!filp || !vma)
     {
-        PDEBUG("Unable to lock mutex for read");
-        return -ERESTARTSYS;
+        return -EINVAL;
     }
 
-    // bounds check the number of commands and command length
-    if ((seek_to.write_cmd > AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED) ||
-        (seek_to.write_cmd_offset >= aesd_dev->buffer.entry[seek_to.write_cmd].size))
+    // use filp private_data to get aesd_dev
+    aesd_dev = aesd_file_dev(filp);
+
+    if (!aesd_dev)
     {
-        mutex_unlock(&aesd_dev->buf_mutex);
-        return -EINVAL;
+        PDEBUG("Unable to use private data");
+        return -EPERM;
     }
 
-    // update fpos (starting offset of the command + write cmd offset)
-    long offset = 0;
-    size_t buf_idx = 0;
-    for (buf_idx = 0; buf_idx < seek_to.write_cmd; buf_idx++)
+    if (!aesd_dev->mmap_area)
     {
-        offset += aesd_dev->buffer.entry[buf_idx].size;
+        return -ENODEV;
     }
 
+    // the mapping is a view of driver owned storage, never let it become writable
+    if (vma->vm_flags & VM_WRITE)
+    {
+        return -EACCES;
+    }
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+    return remap_vmalloc_range(vma, aesd_dev->mmap_area, vma->vm_pgoff);
+}
+
+__poll_t aesd_poll(struct file *filp, poll_table *wait)
+{
+    __poll_t mask = EPOLLOUT | EPOLLWRNORM;
+    size_t entry_offset = 0;
+    loff_t pos = 0;
+    struct aesd_dev *aesd_dev = NULL;
+
+    // check for filp being valid
+    if (!filp)
+    {
+        return EPOLLERR;
+    }
+
+    // use filp private_data to get aesd_dev
+    aesd_dev = aesd_file_dev(filp);
+
+    if (!aesd_dev)
+    {
+        PDEBUG("Unable to use private data");
+        return EPOLLERR;
+    }
+
+    poll_wait(filp, &aesd_dev->read_queue, wait);
+
+    // readable whenever there is data at or after this file's position
+    // the lookup may skip an evicted position forward, which only read() gets to do
+    pos = filp->f_pos;
+    aesd_dev_lock(aesd_dev);
+    if (aesd_dev_find_entry(aesd_dev, &pos, &entry_offset))
+    {
+        mask |= EPOLLIN | EPOLLRDNORM;
+    }
     mutex_unlock(&aesd_dev->buf_mutex);
-    filp->f_pos = offset + seek_to.write_cmd_offset;
-    PDEBUG("updated fpos %lld",filp->f_pos);
 
-    return 0;
+    return mask;
 }
 
 struct file_operations aesd_fops = {
@@ -351,49 +1187,182 @@ struct file_operations aesd_fops = {
     .read =     aesd_read,
     .write =    aesd_write,
     .unlocked_ioctl = aesd_ioctl,
+    .mmap =     aesd_mmap,
+    .poll =     aesd_poll,
     .open =     aesd_open,
     .release =  aesd_release,
 };
 
-static int aesd_setup_cdev(struct aesd_dev *dev)
+static int aesd_stats_show(struct seq_file *s, void *unused)
 {
-    int err, devno = MKDEV(aesd_major, aesd_minor);
+    struct aesd_stats stats;
+
+    aesd_dev_stats(s->private, &stats);
+    seq_printf(s, "writes %llu\n", stats.writes);
+    seq_printf(s, "reads %llu\n", stats.reads);
+    seq_printf(s, "bytes_written %llu\n", stats.bytes_written);
+    seq_printf(s, "bytes_read %llu\n", stats.bytes_read);
+    seq_printf(s, "commits %llu\n", stats.commits);
+    seq_printf(s, "evictions %llu\n", stats.evictions);
+    seq_printf(s, "entries_held %llu\n", stats.entries_held);
+    seq_printf(s, "bytes_held %llu\n", stats.bytes_held);
+    seq_printf(s, "lock_contended %llu\n", stats.lock_contended);
+    seq_printf(s, "alloc_failures %llu\n", stats.alloc_failures);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(aesd_stats);
+
+static int aesd_setup_cdev(struct aesd_dev *dev, int index)
+{
+    int err, devno = MKDEV(aesd_major, aesd_minor + index);
 
     cdev_init(&dev->cdev, &aesd_fops);
     dev->cdev.owner = THIS_MODULE;
     dev->cdev.ops = &aesd_fops;
     err = cdev_add (&dev->cdev, devno, 1);
     if (err) {
-        printk(KERN_ERR "Error %d adding aesd cdev", err);
+        printk(KERN_ERR "Error %d adding aesd cdev %d", err, index);
     }
     return err;
 }
 
+/**
+ * Initialize the AESD specific portion of a single device
+ * @return 0 on success or a negative errno
+ */
+static int aesd_dev_init(struct aesd_dev *dev)
+{
+    memset(dev,0,sizeof(struct aesd_dev));
+
+    // init mutex and circular buffer so they are ready/available when driver is loaded
+    mutex_init(&dev->buf_mutex);
+    init_waitqueue_head(&dev->read_queue);
+
+    aesd_circular_buffer_init(&dev->buffer);
+
+    dev->stats = alloc_percpu(struct aesd_pcpu_stats);
+    if (!dev->stats)
+    {
+        mutex_destroy(&dev->buf_mutex);
+        return -ENOMEM;
+    }
+
+    if (aesd_mmap_slot_size > 0)
+    {
+        dev->mmap_slot_size = PAGE_ALIGN(aesd_mmap_slot_size);
+        dev->mmap_area = vmalloc_user(PAGE_SIZE +
+                                      AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED * dev->mmap_slot_size);
+        if (!dev->mmap_area)
+        {
+            free_percpu(dev->stats);
+            mutex_destroy(&dev->buf_mutex);
+            return -ENOMEM;
+        }
+        dev->mmap_area->magic = AESD_MMAP_MAGIC;
+        dev->mmap_area->version = AESD_MMAP_VERSION;
+        dev->mmap_area->data_offset = PAGE_SIZE;
+        dev->mmap_area->slot_size = dev->mmap_slot_size;
+    }
+
+    return 0;
+}
+
+/**
+ * Release everything held by a single device initialized with aesd_dev_init
+ */
+static void aesd_dev_cleanup(struct aesd_dev *dev)
+{
+    int idx = 0;
+    struct aesd_buffer_entry *entry = NULL;
+
+    aesd_entry_pool_free(dev->working_entry.buffptr, dev->working_entry.size);
+    dev->working_entry.buffptr = NULL;
+
+    AESD_CIRCULAR_BUFFER_FOREACH(entry, &dev->buffer, idx)
+    {
+       aesd_entry_release(dev, entry->buffptr, entry->size);
+    }
+    vfree(dev->mmap_area);
+    free_percpu(dev->stats);
+
+    mutex_destroy(&dev->buf_mutex);
+}
+
 int aesd_init_module(void)
 {
     dev_t dev = 0;
     int result;
-    result = alloc_chrdev_region(&dev, aesd_minor, 1,
+    int i;
+
+    if (aesd_nr_devs < 1)
+    {
+        printk(KERN_WARNING "aesd_nr_devs must be at least 1\n");
+        return -EINVAL;
+    }
+
+    result = aesd_entry_pool_init();
+    if (result)
+    {
+        printk(KERN_WARNING "Can't create aesdchar entry caches\n");
+        return result;
+    }
+
+    result = alloc_chrdev_region(&dev, aesd_minor, aesd_nr_devs,
             "aesdchar");
     aesd_major = MAJOR(dev);
     if (result < 0) {
         printk(KERN_WARNING "Can't get major %d\n", aesd_major);
+        aesd_entry_pool_destroy();
         return result;
     }
-    memset(&aesd_device,0,sizeof(struct aesd_dev));
-
-    /* initialize the AESD specific portion of the device */
 
-    // init mutex and circular buffer so they are ready/available when driver is loaded
-    mutex_init(&aesd_device.buf_mutex);
+    aesd_devices = kcalloc(aesd_nr_devs, sizeof(struct aesd_dev), GFP_KERNEL);
+    if (!aesd_devices)
+    {
+        unregister_chrdev_region(dev, aesd_nr_devs);
+        aesd_entry_pool_destroy();
+        return -ENOMEM;
+    }
 
-    aesd_circular_buffer_init(&aesd_device.buffer);
+    /* initialize the AESD specific portion of each device */
+    for (i = 0; i < aesd_nr_devs; i++)
+    {
+        result = aesd_dev_init(&aesd_devices[i]);
+        if (result)
+        {
+            break;
+        }
 
-    result = aesd_setup_cdev(&aesd_device);
+        result = aesd_setup_cdev(&aesd_devices[i], i);
+        if (result)
+        {
+            aesd_dev_cleanup(&aesd_devices[i]);
+            break;
+        }
+    }
 
     if (result)
     {
-        unregister_chrdev_region(dev, 1);
+        // unwind the devices that were fully set up before the failure
+        while (--i >= 0)
+        {
+            cdev_del(&aesd_devices[i].cdev);
+            aesd_dev_cleanup(&aesd_devices[i]);
+        }
+        kfree(aesd_devices);
+        unregister_chrdev_region(dev, aesd_nr_devs);
+        aesd_entry_pool_destroy();
+        return result;
+    }
+
+    // counters are also exposed under debugfs, failing to create them isn't fatal
+    aesd_debugfs_root = debugfs_create_dir("aesdchar", NULL);
+    for (i = 0; i < aesd_nr_devs; i++)
+    {
+        char name[16];
+
+        snprintf(name, sizeof(name), "aesdchar%d", i);
+        debugfs_create_file(name, 0444, aesd_debugfs_root, &aesd_devices[i], &aesd_stats_fops);
     }
 
     return result;
@@ -402,22 +1371,22 @@ int aesd_init_module(void)
 void aesd_cleanup_module(void)
 {
     dev_t devno = MKDEV(aesd_major, aesd_minor);
+    int i;
 
-    cdev_del(&aesd_device.cdev);
-
-    /* cleanup AESD specific poritions here as necessary */
-    aesd_device.working_entry.buffptr = NULL;
+    debugfs_remove_recursive(aesd_debugfs_root);
 
-    int idx = 0;
-    struct aesd_buffer_entry *entry = NULL;
-    AESD_CIRCULAR_BUFFER_FOREACH(entry, &aesd_device.buffer, idx)
+    for (i = 0; i < aesd_nr_devs; i++)
     {
-       kfree(entry->buffptr);
+        cdev_del(&aesd_devices[i].cdev);
+
+        /* cleanup AESD specific poritions here as necessary */
+        aesd_dev_cleanup(&aesd_devices[i]);
     }
+    kfree(aesd_devices);
 
-    mutex_destroy(&aesd_device.buf_mutex);
+    aesd_entry_pool_destroy();
 
-    unregister_chrdev_region(devno, 1);
+    unregister_chrdev_region(devno, aesd_nr_devs);
 }
 
 module_init(aesd_init_module);
@@ -4,9 +4,10 @@ mode=$1
 
 case "$1" in
     # Start aesdsocket in daemon mode
+    # Extra options, e.g. replication settings, can be passed in AESDSOCKET_OPTS
     start)
         echo "Starting aesdsocket as daemon"
-        start-stop-daemon --start -n aesdsocket --startas /usr/bin/aesdsocket -- -d
+        start-stop-daemon --start -n aesdsocket --startas /usr/bin/aesdsocket -- -d $AESDSOCKET_OPTS
         ;;
     # Stop aesdsocket and send SIGTERM
     stop)
@@ -21,7 +21,34 @@
 #include <stdbool.h>
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <stdint.h>
+#include <errno.h>
+#include <stddef.h>
 #include "../aesd-char-driver/aesd_ioctl.h"
+#include "../aesd-char-driver/aesd-delim.h"
+#include "timecache.h"
+#include "timerwheel.h"
+#include "chunkpool.h"
+#include "replication.h"
+#include "packet.h"
+#include "subscribe.h"
+#include "udp.h"
+#ifdef AESD_COMPRESS
+#include "segment.h"
+#endif
+#ifdef AESD_TLS
+#include "tls.h"
+#endif
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <limits.h>
+
+// limits.h only defines it for XOPEN builds, Linux accepts 1024 iovecs per call
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 #define USE_AESD_CHAR_DEVICE 1
 
@@ -35,13 +62,77 @@
 #endif
 
 const char * PORT = "9000";
-const int buf_size = 512;
-const int timer_dur_s = 10;
+
+// Optional AF_UNIX listener for producers on the same host, served like TCP clients.
+// A local client that sends LOG_FD_COMMAND is passed a read only log descriptor
+// over SCM_RIGHTS, along with one byte of data, and can read the log directly.
+// With -Z that file would only hold the live segment, so the command is refused.
+const char * unix_path = NULL;
+// Optional UDP port taking one record per datagram, nothing is sent back
+const char * udp_port = NULL;
+// A regular log file is sealed and compressed each time it reaches this size, 0 never
+size_t segment_bytes = 0;
+#define LOG_FD_COMMAND "AESDSOCKET_GETFD\n"
+
+// Replication: a primary serves followers on repl_port, a follower follows repl_primary.
+// Followers are not authenticated, so the port is on loopback unless -B names an address
+// such as :: for every interface.
+const char * repl_port = NULL;
+const char * repl_address = "127.0.0.1";
+const char * repl_primary = NULL;
+uint64_t repl_start_seq = 0;
+bool repl_start_seq_given = false;
+// Where a follower keeps the next packet it wants, so a restart without -S carries on
+const char * repl_state_file = "/var/tmp/aesdsocketrepl";
+enum repl_ack_level repl_ack_level = REPL_ACK_ASYNC;
+const size_t repl_backlog_bytes = 16 * 1024 * 1024;
+const int repl_ack_timeout_ms = 1000;
+// Sequence number of the next packet committed, protected by log_mutex
+uint64_t commit_seq = 0;
+// Most packets commit_batch() takes at once
+#define COMMIT_BATCH_MAX 64
+
+// Certificate chain and key for TLS on the client port, plaintext when not given
+const char * tls_cert_file = NULL;
+const char * tls_key_file = NULL;
+
+// What happens to a subscriber whose queue fills up
+enum subscribe_policy subscribe_policy = SUBSCRIBE_DROP;
+
+// Timestamps are only logged to the plain file, the char device holds client records only
+#ifdef USE_AESD_CHAR_DEVICE
+    int timestamp_interval_s = 0;
+#else
+    int timestamp_interval_s = 10;
+#endif
+const char * timestamp_format = "timestamp: %Y, %m, %d, %H, %M, %S";
+// Second resolution part of the per record receive timestamp, microseconds are appended
+const char * record_timestamp_format = "%Y-%m-%dT%H:%M:%S";
+bool record_timestamps = false;
+
+struct timecache timestamp_cache;
+struct timecache record_timestamp_cache;
+
+// Connection deadlines in seconds, 0 disables.  Idle counts from the last successful
+// recv or send, total from accept.  Drain bounds how long shutdown waits for clients.
+// Idle defaults to a minute so a silent client cannot hold a thread forever, -I 0
+// turns it off.  Subscribers are exempt since they only ever read.
+int idle_timeout_s = 60;
+int total_timeout_s = 0;
+int drain_timeout_s = 5;
+
+// Caps on received bytes not yet committed.  Without -M one connection may hold
+// an eighth of the global cap so a single client cannot starve the rest, -M 0
+// turns the per connection cap off.
+// The global cap bounds the shared receive pool, so it is rounded to whole chunks.
+#define MAX_CONNECTION_SHARE 8
+size_t max_connection_bytes = 0;
+size_t max_inflight_bytes = 64 * 1024 * 1024;
+struct chunk_pool recv_pool;
 
 int sock_fd = -1;
-bool timer_fired = false;
+int unix_sock_fd = -1;
 bool signal_caught = false;
-timer_t timer_id;
 
 typedef struct thread_data_t thread_data_t;
 struct thread_data_s {
@@ -49,6 +140,18 @@ struct thread_data_s {
     int         client_fd;
     pthread_t   thread_id;
     SLIST_ENTRY(thread_data_s) entries;
+    // client_fd is closed by the client thread and shut down by the accept loop when a
+    // deadline passes, fd_lock keeps the latter from hitting a reused descriptor
+    pthread_mutex_t fd_lock;
+    bool        expired;
+    bool        subscriber;     /* idle by design, so exempt from the idle deadline */
+    bool        local;          /* accepted on the AF_UNIX listener, never TLS */
+    uint64_t    start_s;
+    uint64_t    last_active_s;
+    struct timer_wheel_timer deadline;
+#ifdef AESD_TLS
+    SSL        *ssl;            /* NULL on a plaintext connection */
+#endif
 };
 
 pthread_mutex_t log_mutex;
@@ -58,12 +161,10 @@ static void signal_handler(int sig_num)
 {
     signal_caught = true;
     shutdown(sock_fd, SHUT_RDWR);
-}
-
-/* Timer signal handler */
-static void timer_handler(int sig, siginfo_t *si, void *uc)
-{
-    timer_fired = true;
+    if (unix_sock_fd != -1)
+    {
+        shutdown(unix_sock_fd, SHUT_RDWR);
+    }
 }
 
 /* Register for all necessary signals */
@@ -83,108 +184,411 @@ int register_signals(void)
         retval = -1;
     }
 
+    // Sends to a connection shut down by a deadline must fail with EPIPE, not kill the process
+    new_action.sa_handler = SIG_IGN;
+    if (sigaction(SIGPIPE, &new_action, NULL))
+    {
+        retval = -1;
+    }
+
     return retval;
 }
 
-/* Initialize the timer.
-   This functionality was based off of example provided at
-   https://man7.org/linux/man-pages/man2/timer_create.2.html */
-int init_timer(void)
+/* Seconds on the monotonic clock, the time base for connection deadlines */
+uint64_t monotonic_seconds(void)
 {
-    int retval = 0;
-    sigset_t mask;
-    struct sigaction sa;
-    struct sigevent  sev;
-    struct itimerspec its;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
 
-    // Setup timer handler
-    sa.sa_flags = SA_SIGINFO;
-    sa.sa_sigaction = timer_handler;
-    sigemptyset(&sa.sa_mask);
-    if (sigaction(SIGRTMIN, &sa, NULL) != 0)
+/* Earliest second at which the connection has run out of time, UINT64_MAX for never */
+uint64_t connection_deadline(struct thread_data_s *conn)
+{
+    uint64_t deadline = UINT64_MAX;
+
+    if ((idle_timeout_s > 0) && !__atomic_load_n(&conn->subscriber, __ATOMIC_RELAXED))
     {
-        retval = -1;
+        deadline = __atomic_load_n(&conn->last_active_s, __ATOMIC_RELAXED) + idle_timeout_s;
+    }
+    if ((total_timeout_s > 0) && (conn->start_s + total_timeout_s < deadline))
+    {
+        deadline = conn->start_s + total_timeout_s;
     }
+    return deadline;
+}
 
-    // Temporarily disable all signals while initializing timer
-    sigemptyset(&mask);
-    sigaddset(&mask, SIGRTMIN);
-    if (sigprocmask(SIG_SETMASK, &mask, NULL) != 0)
+/* Shut down a connection still in progress, waking its thread out of recv or send.
+   The thread sees expired and drops the connection without logging its partial packet. */
+void expire_connection(struct thread_data_s *conn)
+{
+    pthread_mutex_lock(&conn->fd_lock);
+    if (conn->client_fd != -1)
     {
-        retval = -1;
+        __atomic_store_n(&conn->expired, true, __ATOMIC_RELAXED);
+        shutdown(conn->client_fd, SHUT_RDWR);
+        syslog(LOG_INFO, "Connection deadline passed, shutting down");
     }
+    pthread_mutex_unlock(&conn->fd_lock);
+}
+
+/* Timer wheel callback for connection deadlines.  Activity since the timer was armed
+   pushes the idle deadline out, in which case the timer is just moved, and a connection
+   that turned into a subscriber with no total deadline drops its timer. */
+void connection_deadline_expired(struct timer_wheel *wheel, struct timer_wheel_timer *timer, void *arg)
+{
+    struct thread_data_s *conn = (struct thread_data_s *)((char *)timer - offsetof(struct thread_data_s, deadline));
+    uint64_t now = *(uint64_t *)arg;
+    uint64_t deadline = connection_deadline(conn);
 
-    // Create timer
-    sev.sigev_notify = SIGEV_SIGNAL;
-    sev.sigev_signo = SIGRTMIN;
-    sev.sigev_value.sival_ptr = &timer_id;
-    if (timer_create(CLOCK_REALTIME, &sev, &timer_id) != 0)
+    if (deadline == UINT64_MAX)
     {
-        retval = -1;
+        return;
+    }
+    if (deadline > now)
+    {
+        timer_wheel_add(wheel, timer, deadline);
+    }
+    else
+    {
+        expire_connection(conn);
+    }
+}
+
+/* Create the periodic timestamp timer as a timerfd, so expirations are picked up by
+   poll() in the accept loop rather than delivered as a signal to whichever thread is
+   running.  Returns the timer fd, or -1 on error. */
+int init_timer(int interval_s)
+{
+    struct itimerspec its;
+
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1)
+    {
+        syslog(LOG_ERR, "Error creating timer");
+        return -1;
     }
 
-    // Start time
-    its.it_value.tv_sec = timer_dur_s;
+    // Start timer
+    its.it_value.tv_sec = interval_s;
     its.it_value.tv_nsec = 0;
     its.it_interval.tv_sec = its.it_value.tv_sec;
     its.it_interval.tv_nsec = its.it_value.tv_nsec;
 
-    if (timer_settime(timer_id, 0, &its, NULL) != 0)
+    if (timerfd_settime(timer_fd, 0, &its, NULL) != 0)
+    {
+        syslog(LOG_ERR, "Error starting timer");
+        close(timer_fd);
+        return -1;
+    }
+
+    return timer_fd;
+}
+
+/* Write every byte described by iov to fd, in IOV_MAX sized groups and resuming after
+   short writes.  Returns 0 or -1. */
+static int write_all_iov(int fd, const struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0)
+    {
+        int group = (iovcnt < IOV_MAX) ? iovcnt : IOV_MAX;
+        size_t expected = 0;
+        int idx;
+
+        for (idx = 0; idx < group; idx++)
+        {
+            expected += iov[idx].iov_len;
+        }
+        ssize_t written = writev(fd, iov, group);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        // finish a short write one buffer at a time
+        for (idx = 0; ((size_t)written < expected) && (idx < group); idx++)
+        {
+            if ((size_t)written >= iov[idx].iov_len)
+            {
+                written -= iov[idx].iov_len;
+                expected -= iov[idx].iov_len;
+                continue;
+            }
+            const char *pos = (const char *)iov[idx].iov_base + written;
+            size_t remaining = iov[idx].iov_len - written;
+            while (remaining)
+            {
+                ssize_t ret = write(fd, pos, remaining);
+                if (ret == -1)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return -1;
+                }
+                pos += ret;
+                remaining -= ret;
+            }
+            expected -= iov[idx].iov_len;
+            written = 0;
+        }
+        iov += group;
+        iovcnt -= group;
+    }
+    return 0;
+}
+
+/* The single path by which packets reach the log.  Appends packets, the ith of which
+   is described by the next iovcnts[i] entries of iov, with one writev, numbers each
+   and hands it to replication and subscribers, all under log_mutex so the log and
+   every stream agree on the order.  Each payload is copied once into a shared packet
+   that all of them reference.  Waits for followers as the ack level requires once the
+   lock is dropped.  Returns 0 or -1. */
+int commit_batch(const struct iovec *iov, const int *iovcnts, int packets)
+{
+    int retval = 0;
+    uint64_t seq;
+    struct shared_packet *shared[COMMIT_BATCH_MAX] = { NULL };
+    int total_iovcnt = 0;
+    int idx;
+
+    if ((packets < 1) || (packets > COMMIT_BATCH_MAX))
+    {
+        return -1;
+    }
+
+    // Copy before taking the lock, and only when someone will read the copy
+    for (idx = 0; idx < packets; idx++)
     {
+        if (repl_port || subscribe_active())
+        {
+            shared[idx] = shared_packet_create(iov + total_iovcnt, iovcnts[idx]);
+            if (!shared[idx])
+            {
+                syslog(LOG_ERR, "Unable to allocate shared packet");
+            }
+        }
+        total_iovcnt += iovcnts[idx];
+    }
+
+    if (pthread_mutex_lock(&log_mutex) != 0)
+    {
+        syslog(LOG_ERR, "Error locking mutex for file write");
         retval = -1;
+        goto put_packets;
     }
 
-    if (sigprocmask(SIG_UNBLOCK, &mask, NULL) != 0)
+    int fd = open(LOG_FILE, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        syslog(LOG_ERR, "Error opening %s for write", LOG_FILE);
+        pthread_mutex_unlock(&log_mutex);
+        retval = -1;
+        goto put_packets;
+    }
+    if (write_all_iov(fd, iov, total_iovcnt) != 0)
     {
+        syslog(LOG_ERR, "Error writing packet");
         retval = -1;
     }
+#ifdef AESD_COMPRESS
+    segment_after_write(fd);
+#endif
+    close(fd);
 
+    // A failed write still uses up its sequence numbers, so followers see them as empty
+    // packets instead of a gap in the backlog.  A follower's numbers are the primary's
+    // and the primary resends a packet that failed here, so it keeps them for the retry.
+    if ((retval != 0) && repl_primary)
+    {
+        pthread_mutex_unlock(&log_mutex);
+        goto put_packets;
+    }
+    for (idx = 0; idx < packets; idx++)
+    {
+        seq = commit_seq++;
+        if (retval == 0)
+        {
+            replication_publish(seq, shared[idx]);
+            subscribe_publish(shared[idx]);
+        }
+        else
+        {
+            replication_publish(seq, NULL);
+        }
+    }
+    pthread_mutex_unlock(&log_mutex);
+
+    // followers ack in order, so the last packet covers the batch
+    if (retval == 0)
+    {
+        replication_wait(seq);
+    }
+
+put_packets:
+    for (idx = 0; idx < packets; idx++)
+    {
+        shared_packet_put(shared[idx]);
+    }
     return retval;
 }
 
+/* Commit one packet, see commit_batch() */
+int commit_packet(const struct iovec *iov, int iovcnt)
+{
+    return commit_batch(iov, &iovcnt, 1);
+}
+
+/* A follower's log only changes through replication, so it must not take writes from
+   its own clients.  Returns true, after logging, when the write should be dropped. */
+static bool reject_client_write(void)
+{
+    if (repl_primary)
+    {
+        syslog(LOG_WARNING, "Following %s, dropping client write", repl_primary);
+        return true;
+    }
+    return false;
+}
+
+/* Follower side of replication, packets from the primary are committed like any other.
+   An empty packet writes nothing but still takes its sequence number, so the numbers
+   here keep matching the primary's. */
+static int apply_replicated_packet(const char *data, size_t len)
+{
+    struct iovec iov = { .iov_base = (void *)data, .iov_len = len };
+
+    if (len == 0)
+    {
+        if (pthread_mutex_lock(&log_mutex) != 0)
+        {
+            syslog(LOG_ERR, "Error locking mutex for empty packet");
+            return -1;
+        }
+        replication_publish(commit_seq++, NULL);
+        pthread_mutex_unlock(&log_mutex);
+        return 0;
+    }
+    return commit_packet(&iov, 1);
+}
+
 /* Handle printing the timestamp.
    This functionality was based off of example provided at 
    https://man7.org/linux/man-pages/man3/strftime.3.html */
 int print_timestamp(void)
 {
     int retval = 0;
-    char buf[200] = {0};
+    char buf[TIMECACHE_TEXT_MAX + 1];
+    size_t len = 0;
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
 
-    time_t t = time(NULL);
-    struct tm *tmp = localtime(&t);
-    if (tmp == NULL)
+    // Write timestamp:time with newline
+    // default is year, month, day, hour (24 hr), minute, second
+    len = timecache_get(&timestamp_cache, &now, buf, sizeof(buf) - 1);
+    if (len == 0)
     {
-        syslog(LOG_ERR, "Error getting localtime");
-        retval = -1;
+        syslog(LOG_ERR, "Error formatting timestamp");
+        return -1;
     }
+    buf[len++] = '\n';
 
-    // Write timestamp:time with newline
-    // year, month, day, hour (24 hr), minute, second
-    if (strftime(buf, sizeof(buf), "timestamp: %Y, %m, %d, %H, %M, %S\n", tmp) == 0)
+    struct iovec iov = { .iov_base = buf, .iov_len = len };
+    retval = commit_packet(&iov, 1);
+
+    return retval;
+}
+
+/* Consume the pending expirations on the timer fd and log one timestamp.
+   Missed ticks are collapsed into a single timestamp rather than logging a burst. */
+int handle_timer(int timer_fd)
+{
+    uint64_t expirations = 0;
+
+    if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
     {
-        syslog(LOG_ERR, "Strftime returned 0");
-        retval = -1;
+        // spurious wakeup, nothing expired yet
+        return (errno == EAGAIN) ? 0 : -1;
     }
-    //printf("%s\n", buf);
-    
-    if (pthread_mutex_lock(&log_mutex) != 0)
+    if (expirations > 1)
     {
-        syslog(LOG_ERR, "Error locking mutex during timer call");
-        retval = -1;
+        syslog(LOG_INFO, "Timer overran by %llu ticks", (unsigned long long)(expirations - 1));
     }
-    else
+
+    return print_timestamp();
+}
+
+/* Format the receive timestamp prefix for a record, "<cached second>.<microseconds> ".
+   Only the microseconds are formatted per record, the rest comes from the per second cache.
+   Returns the prefix length, or 0 if it could not be formatted. */
+size_t format_record_timestamp(const struct timespec *now, char *buf, size_t buf_size)
+{
+    const size_t usec_len = 8; // '.', six digits and a space
+    long usec = now->tv_nsec / 1000;
+    int digit;
+
+    if (buf_size <= usec_len)
+    {
+        return 0;
+    }
+    size_t len = timecache_get(&record_timestamp_cache, now, buf, buf_size - usec_len);
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    buf[len] = '.';
+    for (digit = 6; digit > 0; digit--)
+    {
+        buf[len + digit] = '0' + (usec % 10);
+        usec /= 10;
+    }
+    buf[len + 7] = ' ';
+    return len + usec_len;
+}
+
+/* Commit function for UDP records.  A batch arrives at once, so its records share one
+   receive timestamp. */
+static int commit_udp_records(const struct iovec *records, int count)
+{
+    struct iovec iov[2 * UDP_BATCH_RECORDS];
+    int iovcnts[UDP_BATCH_RECORDS];
+    char stamp[TIMECACHE_TEXT_MAX + 8];
+    size_t stamp_len = 0;
+    int iovcnt = 0;
+    int idx;
+
+    _Static_assert(UDP_BATCH_RECORDS <= COMMIT_BATCH_MAX, "UDP batch must fit one commit");
+    if (reject_client_write())
+    {
+        return -1;
+    }
+    if (record_timestamps)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        stamp_len = format_record_timestamp(&now, stamp, sizeof(stamp));
+    }
+    for (idx = 0; idx < count; idx++)
     {
-        FILE *fp = fopen(LOG_FILE, "a+");     
-        fputs(buf, fp);
-        fclose(fp);
-        if (pthread_mutex_unlock(&log_mutex) != 0)
+        iovcnts[idx] = 0;
+        if (stamp_len)
         {
-            syslog(LOG_ERR, "Error unlocking thread");
-            retval = -1;
+            iov[iovcnt].iov_base = stamp;
+            iov[iovcnt].iov_len = stamp_len;
+            iovcnt++;
+            iovcnts[idx]++;
         }
+        iov[iovcnt++] = records[idx];
+        iovcnts[idx]++;
     }
-
-    return retval;
+    return commit_batch(iov, iovcnts, count);
 }
 
 // Below function to get address info was utilized from the BGNet guide
@@ -196,6 +600,203 @@ void *get_in_addr(struct sockaddr *sa)
     : (void *) &(((struct sockaddr_in6*)sa)->sin6_addr);
 }
 
+/* Receive from a client, through TLS when the connection has it.  Same returns as recv(). */
+static ssize_t client_recv(struct thread_data_s *conn, void *buf, size_t len)
+{
+#ifdef AESD_TLS
+    if (conn->ssl)
+    {
+        return tls_recv(conn->ssl, buf, len);
+    }
+#endif
+    return recv(conn->client_fd, buf, len, 0);
+}
+
+/* Send all of buf to a client, through TLS when the connection has it.  Returns 0 or -1. */
+static int client_send_all(void *arg, const char *buf, size_t len)
+{
+    struct thread_data_s *conn = arg;
+
+#ifdef AESD_TLS
+    if (conn->ssl)
+    {
+        return tls_send_all(conn->ssl, buf, len);
+    }
+#endif
+    while (len)
+    {
+        ssize_t sent = send(conn->client_fd, buf, len, 0);
+        if (sent == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        buf += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+/* With kTLS the kernel encrypts, so a regular log file can go back to the client with
+   sendfile and never pass through userspace.  Returns 1 if the log was sent this way,
+   0 if the caller has to read and send it, -1 on error. */
+static int client_sendfile_log(struct thread_data_s *conn, FILE *fp)
+{
+#ifdef AESD_TLS
+    struct stat st;
+    off_t offset;
+
+    if (!conn->ssl || !tls_ktls_send(conn->ssl))
+    {
+        return 0;
+    }
+    // the char device has no size and no splice support, it is always read and sent
+    offset = lseek(fileno(fp), 0, SEEK_CUR);
+    if ((fstat(fileno(fp), &st) != 0) || !S_ISREG(st.st_mode) || (offset == -1))
+    {
+        return 0;
+    }
+    if (st.st_size > offset)
+    {
+        if (tls_sendfile(conn->ssl, fileno(fp), offset, st.st_size - offset) != 0)
+        {
+            return -1;
+        }
+        syslog(LOG_INFO, "Sent %lld bytes with sendfile", (long long)(st.st_size - offset));
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/* Pass a fresh read only descriptor for the log to a local client.  Returns 0 or -1. */
+static int send_log_fd(int client_fd)
+{
+    char byte = 0;
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    struct cmsghdr *cmsg;
+    int retval = 0;
+
+    // older records sit in sealed segments the client cannot see through this descriptor
+    if (segment_bytes)
+    {
+        syslog(LOG_WARNING, "Log is segmented, refusing to pass log descriptor");
+        return -1;
+    }
+
+    int log_fd = open(LOG_FILE, O_RDONLY | O_CLOEXEC);
+    if (log_fd == -1)
+    {
+        syslog(LOG_ERR, "Error opening %s for a local client", LOG_FILE);
+        return -1;
+    }
+    memset(&control, 0, sizeof(control));
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &log_fd, sizeof(int));
+
+    if (sendmsg(client_fd, &msg, MSG_NOSIGNAL) != 1)
+    {
+        syslog(LOG_ERR, "Error passing log descriptor");
+        retval = -1;
+    }
+    else
+    {
+        syslog(LOG_INFO, "Passed log descriptor to local client");
+    }
+    // the client holds its own reference now
+    close(log_fd);
+    return retval;
+}
+
+#ifdef AESD_COMPRESS
+/* Send the whole log as one gzip stream: stored segments as they are, then the rest
+   compressed on the way out.  Returns 0 or -1. */
+static int send_log_gzip(struct thread_data_s *conn)
+{
+    int retval = 0;
+
+    // segments and live file taken together, so a seal in between can't skip or repeat data
+    pthread_mutex_lock(&log_mutex);
+    unsigned int sealed = segment_count();
+    int fd = open(LOG_FILE, O_RDONLY | O_CLOEXEC);
+    pthread_mutex_unlock(&log_mutex);
+
+    if (segment_send(sealed, true, client_send_all, conn) != 0)
+    {
+        retval = -1;
+    }
+    if ((retval == 0) && (fd != -1) && (segment_send_gzip_fd(fd, client_send_all, conn) != 0))
+    {
+        retval = -1;
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    return retval;
+}
+#endif
+
+/* Bind and listen on an AF_UNIX stream socket at path, replacing a stale socket left
+   by an earlier run.  Returns the socket or -1. */
+static int open_unix_listener(const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        syslog(LOG_ERR, "Local socket path %s too long", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    if ((lstat(path, &st) == 0) && S_ISSOCK(st.st_mode))
+    {
+        unlink(path);
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        syslog(LOG_ERR, "Error creating local socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        syslog(LOG_ERR, "Error binding local socket %s", path);
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, 5) != 0)
+    {
+        syslog(LOG_ERR, "Error listening on local socket");
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
 // Thread function (move receive/send here, set complete flag)
 // mutex lock/unlock around writing to /var/tmp/aesdsocketdata
 // exit when connection closed or error during send/receive
@@ -204,26 +805,62 @@ int handle_client(struct thread_data_s* thread_func_args)
     int retval = 0;
     int client_fd = thread_func_args->client_fd;
     FILE *fp;
-    char buf[512] = {0};
-    int  bytes_recv, total_bytes_recv = 0;
+    int  bytes_recv;
+    size_t total_bytes_recv = 0;
+    size_t new_line_pos;
     bool more_bytes_to_read = true;
-    char * new_line_found = NULL;
+    bool over_limit = false;
+    struct timespec recv_time;
+    char   recv_stamp[TIMECACHE_TEXT_MAX + 8];
+    size_t recv_stamp_len = 0;
+    // The packet is received into a chain of pool chunks, never copied or reallocated
+    struct chunk *first_chunk = NULL;
+    struct chunk *last_chunk = NULL;
+    struct chunk *chunk;
     // Result will be set to 0 if ioctl command is found (using strcmp)
     int ioctl_cmd_found = -1;
 
-    // Create a buffer to store the final packet
-    char *final_buffer = malloc(1);
-    if (!final_buffer)
+#ifdef AESD_TLS
+    // The handshake runs here rather than in the accept loop, under the connection deadline
+    if (tls_cert_file && !thread_func_args->local)
     {
-        syslog(LOG_ERR, "Malloc failure");
-        retval = -1;
+        thread_func_args->ssl = tls_accept(client_fd);
+        if (!thread_func_args->ssl)
+        {
+            retval = -1;
+            goto close_client;
+        }
     }
-    *final_buffer = '\0';
+#endif
 
     // Receive all available bytes from the client
     while (more_bytes_to_read && !(retval == -1))
     {
-        bytes_recv = recv(client_fd, buf, 512, 0);
+        // Take another chunk from the shared pool once the last one is full
+        if (!last_chunk || (last_chunk->len == sizeof(last_chunk->data)))
+        {
+            chunk = chunk_pool_get(&recv_pool);
+            if (!chunk)
+            {
+                syslog(LOG_ERR, "Receive pool exhausted, dropping connection");
+                over_limit = true;
+                retval = -1;
+                continue;
+            }
+            if (last_chunk)
+            {
+                last_chunk->next = chunk;
+            }
+            else
+            {
+                first_chunk = chunk;
+            }
+            last_chunk = chunk;
+        }
+
+        // Receive straight into the end of the packet
+        bytes_recv = client_recv(thread_func_args, last_chunk->data + last_chunk->len,
+                                 sizeof(last_chunk->data) - last_chunk->len);
         syslog(LOG_INFO, "Received %d bytes", bytes_recv);
         if (bytes_recv == -1)
         {
@@ -237,31 +874,33 @@ int handle_client(struct thread_data_s* thread_func_args)
         }
         else
         {
-            // Calculate the new buffer size needed to store packet and realloc
-            int new_buf_len = strlen(final_buffer) + strlen(buf) + 1;
-            char *tmp_buf = realloc(final_buffer, new_buf_len);
-            if (!tmp_buf)
+            __atomic_store_n(&thread_func_args->last_active_s, monotonic_seconds(), __ATOMIC_RELAXED);
+
+            // Check to see if we've gotten new line and are finished receiving
+            // Earlier bytes were already scanned, so only look at what just arrived
+            if (aesd_delim_scan(last_chunk->data + last_chunk->len, bytes_recv, '\n', &new_line_pos, 1) != 0)
             {
-                syslog(LOG_ERR, "Realloc failure");
-                retval = -1;
-                continue;
+                more_bytes_to_read = false;
             }
-
-            // Move contents of most recent recv into final buffer
-            final_buffer = tmp_buf;
+            last_chunk->len += bytes_recv;
             total_bytes_recv += bytes_recv;
-            strcpy(final_buffer, buf);
 
-            // Check to see if we've gotten new line and are finished receiving
-            new_line_found = memchr(final_buffer, '\n', 512);
-            if (new_line_found != NULL)
+            // A packet that outgrows the per connection cap without a newline is dropped
+            if ((max_connection_bytes > 0) && (total_bytes_recv > max_connection_bytes))
             {
-                more_bytes_to_read = false;
+                syslog(LOG_ERR, "Packet exceeds %zu bytes, dropping connection", max_connection_bytes);
+                over_limit = true;
+                retval = -1;
+                continue;
             }
 
             #ifdef USE_AESD_CHAR_DEVICE
             // Check to see if we've gotten the ioctl command and the other arguments
-            ioctl_cmd_found = strncmp(final_buffer, AESD_CHAR_IOCTL_CMD, CMD_IDENTIFIER_LEN);
+            // The command is far shorter than a chunk, so it is always in the first one
+            if (first_chunk->len >= CMD_IDENTIFIER_LEN)
+            {
+                ioctl_cmd_found = memcmp(first_chunk->data, AESD_CHAR_IOCTL_CMD, CMD_IDENTIFIER_LEN);
+            }
             if ((total_bytes_recv >= TOTAL_CMD_LEN) && (ioctl_cmd_found == 0))
             {
                 syslog(LOG_INFO, "Received ioctl cmd");
@@ -271,14 +910,72 @@ int handle_client(struct thread_data_s* thread_func_args)
         }
     }
 
+    // A connection cut off by its deadline or limits is dropped without logging what it sent
+    if (over_limit || __atomic_load_n(&thread_func_args->expired, __ATOMIC_RELAXED))
+    {
+        syslog(LOG_INFO, "Dropping %zu bytes from expired connection", total_bytes_recv);
+        chunk_pool_put(&recv_pool, first_chunk);
+        goto close_client;
+    }
+
+    // Stamp the packet with the time its last bytes arrived
+    if (record_timestamps && (retval == 0))
+    {
+        clock_gettime(CLOCK_REALTIME, &recv_time);
+        recv_stamp_len = format_record_timestamp(&recv_time, recv_stamp, sizeof(recv_stamp));
+    }
+
+    // A subscriber keeps the connection and is pushed packets until it leaves
+    if ((retval == 0) && (total_bytes_recv == strlen(SUBSCRIBE_COMMAND)) &&
+        (memcmp(first_chunk->data, SUBSCRIBE_COMMAND, total_bytes_recv) == 0))
+    {
+        syslog(LOG_INFO, "Client subscribed");
+        __atomic_store_n(&thread_func_args->subscriber, true, __ATOMIC_RELAXED);
+        chunk_pool_put(&recv_pool, first_chunk);
+        if (subscribe_serve(client_fd, client_send_all, thread_func_args) != 0)
+        {
+            retval = -1;
+        }
+        goto close_client;
+    }
+
+    // A local client can take the log descriptor and read the log without us
+    if (thread_func_args->local && (retval == 0) && (total_bytes_recv == strlen(LOG_FD_COMMAND)) &&
+        (memcmp(first_chunk->data, LOG_FD_COMMAND, total_bytes_recv) == 0))
+    {
+        chunk_pool_put(&recv_pool, first_chunk);
+        if (send_log_fd(client_fd) != 0)
+        {
+            retval = -1;
+        }
+        goto close_client;
+    }
+
+#ifdef AESD_COMPRESS
+    // Compressed readback is asked for on its own, nothing is committed
+    if ((retval == 0) && (total_bytes_recv == strlen(SEGMENT_GZIP_COMMAND)) &&
+        (memcmp(first_chunk->data, SEGMENT_GZIP_COMMAND, total_bytes_recv) == 0))
+    {
+        syslog(LOG_INFO, "Sending compressed log");
+        chunk_pool_put(&recv_pool, first_chunk);
+        if (send_log_gzip(thread_func_args) != 0)
+        {
+            retval = -1;
+        }
+        goto close_client;
+    }
+#endif
+
     // We've either gotten the ioctl command or we're ready to write to the log file
     if (ioctl_cmd_found == 0)
     {
         #ifdef USE_AESD_CHAR_DEVICE
         struct aesd_seekto seekto;
         // separate out the command portions of the input string and convert to unsigned integers
-        char * write_cmd = &final_buffer[CMD_IDENTIFIER_LEN];
-        char * write_offset = &final_buffer[TOTAL_CMD_LEN-1];
+        char cmd_buf[64] = {0};
+        memcpy(cmd_buf, first_chunk->data, (first_chunk->len < sizeof(cmd_buf)) ? first_chunk->len : sizeof(cmd_buf) - 1);
+        char * write_cmd = &cmd_buf[CMD_IDENTIFIER_LEN];
+        char * write_offset = &cmd_buf[TOTAL_CMD_LEN-1];
         seekto.write_cmd = strtoul(write_cmd, NULL, 10);
         seekto.write_cmd_offset = strtoul(write_offset, NULL, 10);
         syslog(LOG_INFO, "Write cmd %u write cmd offset %u", seekto.write_cmd, seekto.write_cmd_offset);
@@ -288,49 +985,111 @@ int handle_client(struct thread_data_s* thread_func_args)
     }
     else
     {
-        // Open file and write the new packet contents
-        if (pthread_mutex_lock(&log_mutex) != 0)
+        // Commit the timestamp prefix and every chunk of the packet as one write
+        // A client that closed without sending anything has nothing to commit
+        int iovcnt = 0;
+        for (chunk = first_chunk; chunk; chunk = chunk->next)
+        {
+            iovcnt++;
+        }
+        struct iovec *iov = total_bytes_recv ? malloc((iovcnt + 1) * sizeof(*iov)) : NULL;
+        if (!total_bytes_recv)
+        {
+            syslog(LOG_INFO, "Empty packet, nothing to write");
+        }
+        else if (reject_client_write())
         {
-            syslog(LOG_ERR, "Error locking mutex for file write");
+            // the client still gets the log back, a follower serves reads
+            retval = -1;
+        }
+        else if (!iov)
+        {
+            syslog(LOG_ERR, "Malloc failure");
             retval = -1;
         }
         else
         {
-            syslog(LOG_INFO, "Got mutex");
-            fp = fopen(LOG_FILE, "a+");
-            fwrite(final_buffer, total_bytes_recv, 1, fp);
+            iovcnt = 0;
+            if (recv_stamp_len)
+            {
+                iov[iovcnt].iov_base = recv_stamp;
+                iov[iovcnt].iov_len = recv_stamp_len;
+                iovcnt++;
+            }
+            for (chunk = first_chunk; chunk; chunk = chunk->next)
+            {
+                iov[iovcnt].iov_base = chunk->data;
+                iov[iovcnt].iov_len = chunk->len;
+                iovcnt++;
+            }
+            if (commit_packet(iov, iovcnt) != 0)
+            {
+                retval = -1;
+            }
             syslog(LOG_INFO, "Completed file write");
-            fclose(fp);
-            pthread_mutex_unlock(&log_mutex);
+            free(iov);
         }
     }    
-    free(final_buffer);
+
+    // Keep the first chunk as the read buffer for sending the log back, return the rest
+    if (first_chunk)
+    {
+        chunk_pool_put(&recv_pool, first_chunk->next);
+        first_chunk->next = NULL;
+    }
 
     // Once write completes, return full content of /var/tmp/aesdsocketdata to client
-    char read_buf[512] = {0};
     int  bytes_read;
 
+    bool readback_failed = false;
+
     // If we're handling an ioctl command, we don't need to open the file pointer again for reading
     if (ioctl_cmd_found != 0)
     {
+#ifdef AESD_COMPRESS
+        // Sealed segments go first, inflated for this plain reader, then the live file
+        pthread_mutex_lock(&log_mutex);
+        unsigned int sealed = segment_count();
+        fp = fopen(LOG_FILE, "r+");
+        pthread_mutex_unlock(&log_mutex);
+        if (first_chunk && sealed && (segment_send(sealed, false, client_send_all, thread_func_args) != 0))
+        {
+            readback_failed = true;
+        }
+#else
         fp = fopen(LOG_FILE, "r+");
+#endif
     }
     
-    while (!feof(fp))
+    int sendfile_ret = readback_failed ? -1 : (first_chunk ? client_sendfile_log(thread_func_args, fp) : 0);
+    if (sendfile_ret == -1)
     {
-        bytes_read = fread(read_buf, 1, 512, fp);
-        char *msg_to_send = read_buf;
-        int bytes_sent = send(client_fd, msg_to_send, bytes_read, 0);
-        if (bytes_sent == -1)
+        syslog(LOG_ERR, "Error sending bytes");
+        retval = -1;
+    }
+    while (first_chunk && (sendfile_ret == 0) && !feof(fp))
+    {
+        bytes_read = fread(first_chunk->data, 1, sizeof(first_chunk->data), fp);
+        char *msg_to_send = first_chunk->data;
+        if (client_send_all(thread_func_args, msg_to_send, bytes_read) != 0)
         {
             syslog(LOG_ERR, "Error sending bytes");
             retval = -1;
+            break;
         }
-        syslog(LOG_INFO, "Read %d bytes, sent %d bytes", bytes_read, bytes_sent);
+        __atomic_store_n(&thread_func_args->last_active_s, monotonic_seconds(), __ATOMIC_RELAXED);
+        syslog(LOG_INFO, "Read and sent %d bytes", bytes_read);
     }
     fclose(fp);
+    chunk_pool_put(&recv_pool, first_chunk);
 
+close_client:
     // Log message to syslog when connection closes
+    pthread_mutex_lock(&thread_func_args->fd_lock);
+#ifdef AESD_TLS
+    tls_close(thread_func_args->ssl);
+    thread_func_args->ssl = NULL;
+#endif
     if (close(client_fd) != 0)
     {
         syslog(LOG_ERR, "Error closing client socket");
@@ -340,6 +1099,8 @@ int handle_client(struct thread_data_s* thread_func_args)
     {
         syslog(LOG_USER, "Closed connection from client");
     }
+    thread_func_args->client_fd = -1;
+    pthread_mutex_unlock(&thread_func_args->fd_lock);
 
     return retval;
 }
@@ -358,13 +1119,172 @@ int main(int argc, char* argv[])
     struct addrinfo hints, *serv_info, *p;
     struct sockaddr_storage client_addr;
     pthread_t thread;
+    int    timer_fd = -1;
+    struct pollfd poll_fds[3];
+    nfds_t poll_count = 1;
+    int    unix_poll_idx = -1;
+    int    timer_poll_idx = -1;
+    int    opt;
+    struct timer_wheel deadlines;
+    uint64_t now_s;
     
-    // Check for daemon
+    // Check for daemon, timestamp interval (0 disables) and strftime format,
+    // connection idle/total deadlines and shutdown drain time
     bool run_daemon = false;
-    if (argc > 1 && (strcmp(argv[1], "-d") == 0))
+    bool max_connection_given = false;
+    while ((opt = getopt(argc, argv, "di:f:tI:T:D:M:G:p:l:R:B:F:A:S:Q:P:C:K:U:u:Z:")) != -1)
     {
-        run_daemon = true;
+        switch (opt)
+        {
+        case 'd':
+            run_daemon = true;
+            break;
+        case 'i':
+            timestamp_interval_s = atoi(optarg);
+            break;
+        case 'f':
+            timestamp_format = optarg;
+            break;
+        case 't':
+            record_timestamps = true;
+            break;
+        case 'I':
+            idle_timeout_s = atoi(optarg);
+            break;
+        case 'T':
+            total_timeout_s = atoi(optarg);
+            break;
+        case 'D':
+            drain_timeout_s = atoi(optarg);
+            break;
+        case 'M':
+            max_connection_bytes = strtoul(optarg, NULL, 10);
+            max_connection_given = true;
+            break;
+        case 'G':
+            max_inflight_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            PORT = optarg;
+            break;
+        case 'l':
+            LOG_FILE = optarg;
+            break;
+        case 'R':
+            repl_port = optarg;
+            break;
+        case 'B':
+            repl_address = optarg;
+            break;
+        case 'F':
+            repl_primary = optarg;
+            break;
+        case 'A':
+            if (strcmp(optarg, "async") == 0)
+            {
+                repl_ack_level = REPL_ACK_ASYNC;
+            }
+            else if (strcmp(optarg, "one") == 0)
+            {
+                repl_ack_level = REPL_ACK_ONE;
+            }
+            else
+            {
+                fprintf(stderr, "Ack level must be async or one\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'S':
+            repl_start_seq = strtoull(optarg, NULL, 10);
+            repl_start_seq_given = true;
+            break;
+        case 'Q':
+            repl_state_file = optarg;
+            break;
+        case 'P':
+            if (strcmp(optarg, "drop") == 0)
+            {
+                subscribe_policy = SUBSCRIBE_DROP;
+            }
+            else if (strcmp(optarg, "skip") == 0)
+            {
+                subscribe_policy = SUBSCRIBE_SKIP;
+            }
+            else
+            {
+                fprintf(stderr, "Subscriber policy must be drop or skip\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'U':
+            unix_path = optarg;
+            break;
+        case 'u':
+            udp_port = optarg;
+            break;
+        case 'Z':
+            segment_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'C':
+            tls_cert_file = optarg;
+            break;
+        case 'K':
+            tls_key_file = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-d] [-i timestamp interval s] [-f timestamp format] [-t] "
+                            "[-I idle timeout s] [-T total timeout s] [-D drain timeout s] "
+                            "[-M max bytes per connection] [-G max bytes in flight] "
+                            "[-p port] [-l log file] [-R replication port [-B replication address] | -F primary host:port] "
+                            "[-A async|one] [-S first sequence number] [-Q follow position file] [-P drop|skip] "
+                            "[-C TLS certificate chain -K TLS key] [-U local socket path] "
+                            "[-u UDP port] [-Z segment bytes]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((tls_cert_file != NULL) != (tls_key_file != NULL))
+    {
+        fprintf(stderr, "TLS needs both a certificate (-C) and a key (-K)\n");
+        exit(EXIT_FAILURE);
+    }
+    // The daemon changes directory, so a relative path would not find the socket to remove
+    if (unix_path && (unix_path[0] != '/'))
+    {
+        fprintf(stderr, "Local socket path must be absolute\n");
+        exit(EXIT_FAILURE);
+    }
+#ifndef AESD_COMPRESS
+    if (segment_bytes)
+    {
+        fprintf(stderr, "Built without compression support, rebuild with make COMPRESS=1\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+#ifndef AESD_TLS
+    if (tls_cert_file)
+    {
+        fprintf(stderr, "Built without TLS support, rebuild with make TLS=1\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    // A follower's log is the primary's, so it never adds timestamps of its own
+    if (repl_primary)
+    {
+        timestamp_interval_s = 0;
+    }
+    // Packets committed here continue the sequence the follower had reached, which it
+    // saved unless -S says where to start
+    if (repl_primary && !repl_start_seq_given)
+    {
+        repl_start_seq = replication_follower_saved_seq(repl_state_file);
     }
+    commit_seq = repl_start_seq;
+
+    subscribe_init(subscribe_policy);
+    timecache_init(&timestamp_cache, timestamp_format);
+    timecache_init(&record_timestamp_cache, record_timestamp_format);
 
     // Register for signals
     if (register_signals() != 0)
@@ -382,6 +1302,28 @@ int main(int argc, char* argv[])
         retval = -1;
     }
 
+    // Give each connection a fair share of the pool unless -M chose a cap
+    if (!max_connection_given)
+    {
+        max_connection_bytes = max_inflight_bytes / MAX_CONNECTION_SHARE;
+    }
+
+    // Initialize shared receive pool
+    if (chunk_pool_init(&recv_pool, max_inflight_bytes) != 0)
+    {
+        syslog(LOG_ERR, "Error initializing receive pool");
+        retval = -1;
+    }
+
+#ifdef AESD_TLS
+    // Load the certificate before listening so a bad one fails at startup
+    if (tls_cert_file && (tls_init(tls_cert_file, tls_key_file) != 0))
+    {
+        syslog(LOG_ERR, "Error initializing TLS");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
     // Initialize SLIST
     SLIST_HEAD(slist_head, thread_data_s) head;
     SLIST_INIT(&head);
@@ -426,6 +1368,16 @@ int main(int argc, char* argv[])
 
     freeaddrinfo(serv_info);
 
+    // Local listener, bound before the fork like the TCP one so errors reach the caller
+    if (unix_path && (retval == 0))
+    {
+        unix_sock_fd = open_unix_listener(unix_path);
+        if (unix_sock_fd == -1)
+        {
+            retval = -1;
+        }
+    }
+
     // Check for daemon, initializing if option was specified
     if (run_daemon)
     {
@@ -474,13 +1426,41 @@ int main(int argc, char* argv[])
         }
     }
 
-    #ifndef USE_AESD_CHAR_DEVICE
-        // Initialize timer - needs to be called after fork
-        if (init_timer() != 0)
+#ifdef AESD_COMPRESS
+    // Start the segment compressor - threads need to be created after fork
+    if (segment_init(LOG_FILE, segment_bytes) != 0)
+    {
+        retval = -1;
+    }
+#endif
+
+    // Start UDP ingestion - threads need to be created after fork
+    if (udp_port && (udp_ingest_start(udp_port, commit_udp_records) != 0))
+    {
+        retval = -1;
+    }
+
+    // Start replication - threads need to be created after fork
+    if (repl_port && (replication_primary_start(repl_address, repl_port, commit_seq, repl_ack_level,
+                                                repl_backlog_bytes, repl_ack_timeout_ms) != 0))
+    {
+        retval = -1;
+    }
+    if (repl_primary && (replication_follower_start(repl_primary, repl_start_seq, repl_state_file,
+                                                    apply_replicated_packet) != 0))
+    {
+        retval = -1;
+    }
+
+    // Initialize timer - needs to be called after fork
+    if (timestamp_interval_s > 0)
+    {
+        timer_fd = init_timer(timestamp_interval_s);
+        if (timer_fd == -1)
         {
             retval = -1;
         }
-    #endif
+    }
     
     // listen for connection
     if (listen(sock_fd, 5) != 0)
@@ -488,22 +1468,82 @@ int main(int argc, char* argv[])
         syslog(LOG_ERR, "Error listening");
         retval = -1;
     }
+
+    // The accept loop sleeps in poll() on the listening sockets and the timer together,
+    // so timestamps go out on time whether or not clients are connecting
+    poll_fds[0].fd = sock_fd;
+    poll_fds[0].events = POLLIN;
+    if (unix_sock_fd != -1)
+    {
+        unix_poll_idx = poll_count++;
+        poll_fds[unix_poll_idx].fd = unix_sock_fd;
+        poll_fds[unix_poll_idx].events = POLLIN;
+    }
+    if (timer_fd != -1)
+    {
+        timer_poll_idx = poll_count++;
+        poll_fds[timer_poll_idx].fd = timer_fd;
+        poll_fds[timer_poll_idx].events = POLLIN;
+    }
+    timer_wheel_init(&deadlines, monotonic_seconds());
     
     // Accept connections until SIGINT or SIGTERM received
     while (!signal_caught && (retval != -1))
     {
-        // accept connection
-        socklen_t client_addr_size = sizeof(client_addr);
-        client_fd = accept(sock_fd, (struct sockaddr *)&client_addr, &client_addr_size);
+        // wake every tick while there are deadlines to check
+        int poll_ret = poll(poll_fds, poll_count, deadlines.armed ? 1000 : -1);
+        if ((poll_ret == -1) && (errno != EINTR))
+        {
+            syslog(LOG_ERR, "Error polling");
+            retval = -1;
+            continue;
+        }
+
+        now_s = monotonic_seconds();
+        timer_wheel_advance(&deadlines, now_s, connection_deadline_expired, &now_s);
+        if (poll_ret == -1)
+        {
+            continue;
+        }
+
+        if ((timer_poll_idx != -1) && (poll_fds[timer_poll_idx].revents & POLLIN))
+        {
+            if (handle_timer(timer_fd) != 0)
+            {
+                retval = -1;
+                continue;
+            }
+        }
+
+        // accept connection, one per pass so neither listener can starve the other
+        client_fd = -1;
+        bool local_client = false;
+        if (poll_fds[0].revents)
+        {
+            socklen_t client_addr_size = sizeof(client_addr);
+            client_fd = accept(sock_fd, (struct sockaddr *)&client_addr, &client_addr_size);
+        }
+        else if ((unix_poll_idx != -1) && poll_fds[unix_poll_idx].revents)
+        {
+            client_fd = accept(unix_sock_fd, NULL, NULL);
+            local_client = true;
+        }
         if (client_fd != -1)
         {
             // log message to syslog when client connects
-            char ip_addr[INET6_ADDRSTRLEN];
-            inet_ntop(client_addr.ss_family,
-                    get_in_addr((struct sockaddr *)&client_addr),
-                    ip_addr, sizeof(ip_addr));
+            if (local_client)
+            {
+                syslog(LOG_USER, "Accepted connection on %s", unix_path);
+            }
+            else
+            {
+                char ip_addr[INET6_ADDRSTRLEN];
+                inet_ntop(client_addr.ss_family,
+                        get_in_addr((struct sockaddr *)&client_addr),
+                        ip_addr, sizeof(ip_addr));
 
-            syslog(LOG_USER, "Accepted connection from %s", ip_addr);
+                syslog(LOG_USER, "Accepted connection from %s", ip_addr);
+            }
 
             // Now that we've accepted connection, declare/init/insert element at head
             // instantiate thread
@@ -516,29 +1556,32 @@ int main(int argc, char* argv[])
             }
             thread_struct->client_fd = client_fd;
             thread_struct->thread_complete = false;        
+            thread_struct->expired = false;
+            thread_struct->subscriber = false;
+            thread_struct->local = local_client;
+#ifdef AESD_TLS
+            thread_struct->ssl = NULL;
+#endif
+            thread_struct->start_s = now_s;
+            thread_struct->last_active_s = now_s;
+            thread_struct->deadline.armed = false;
+            pthread_mutex_init(&thread_struct->fd_lock, NULL);
             int id = pthread_create(&thread, NULL, thread_func, thread_struct);        
             if (id != 0)
             {
                 syslog(LOG_ERR, "Error creating new thread");
+                pthread_mutex_destroy(&thread_struct->fd_lock);
                 free(thread_struct);
                 retval = -1;
                 continue;
             }
             thread_struct->thread_id = thread;
             SLIST_INSERT_HEAD(&head, thread_struct, entries);
-        }        
-
-        #ifndef USE_AESD_CHAR_DEVICE
-            if (timer_fired)
+            if (connection_deadline(thread_struct) != UINT64_MAX)
             {
-                if (print_timestamp() != 0)
-                {
-                    retval = -1;
-                    continue;
-                }
-                timer_fired = false;
+                timer_wheel_add(&deadlines, &thread_struct->deadline, connection_deadline(thread_struct));
             }
-        #endif
+        }        
 
         // iterate over linked list, remove from list if flag is set
         // also call pthread join 
@@ -559,12 +1602,43 @@ int main(int argc, char* argv[])
                     retval = -1;
                 }
                 SLIST_REMOVE(&head, thread_ptr, thread_data_s, entries);
+                timer_wheel_del(&deadlines, &thread_ptr->deadline);
+                pthread_mutex_destroy(&thread_ptr->fd_lock);
                 free(thread_ptr);
             }
         }
     }
 
     syslog(LOG_USER, "Caught signal, exiting");
+
+    // Subscribers never finish on their own, let them go before waiting on the rest
+    subscribe_stop();
+
+    // Drain: give connections in progress up to drain_timeout_s to finish on their own,
+    // then shut down whatever is left so a stalled client can't hold up the exit
+    uint64_t drain_deadline = monotonic_seconds() + drain_timeout_s;
+    struct thread_data_s *thread_ptr = NULL;
+    bool draining = true;
+    while (draining && (monotonic_seconds() <= drain_deadline))
+    {
+        draining = false;
+        SLIST_FOREACH(thread_ptr, &head, entries)
+        {
+            if (!thread_ptr->thread_complete)
+            {
+                draining = true;
+                break;
+            }
+        }
+        if (draining)
+        {
+            poll(NULL, 0, 100);
+        }
+    }
+    SLIST_FOREACH(thread_ptr, &head, entries)
+    {
+        expire_connection(thread_ptr);
+    }
     
     // Request exit from each thread and wait for complete
     while (!SLIST_EMPTY(&head))
@@ -572,18 +1646,43 @@ int main(int argc, char* argv[])
         struct thread_data_s *thread_rm = SLIST_FIRST(&head);
         pthread_join(thread_rm->thread_id, NULL);
         SLIST_REMOVE_HEAD(&head, entries);
+        pthread_mutex_destroy(&thread_rm->fd_lock);
         free(thread_rm);
     }
 
+    if (timer_fd != -1)
+    {
+        close(timer_fd);
+    }
+
+    udp_ingest_stop();
+    replication_stop();
+#ifdef AESD_TLS
+    tls_cleanup();
+#endif
+
+    #ifdef AESD_COMPRESS
+        #ifdef USE_AESD_CHAR_DEVICE
+            segment_stop(false);
+        #else
+            segment_stop(true);
+        #endif
+    #endif
+
     #ifndef USE_AESD_CHAR_DEVICE
-        timer_delete(timer_id);
         remove(LOG_FILE);
     #endif
 
     syslog(LOG_INFO, "Closing aesdsocket application");
     pthread_mutex_destroy(&log_mutex);
+    chunk_pool_destroy(&recv_pool);
     closelog();
     close(sock_fd);
+    if (unix_sock_fd != -1)
+    {
+        close(unix_sock_fd);
+        unlink(unix_path);
+    }
 
     return retval;
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026   */
+
+#include "chunkpool.h"
+
+#include <stdlib.h>
+
+int chunk_pool_init(struct chunk_pool *pool, size_t max_bytes)
+{
+    pool->free_list = NULL;
+    pool->max_chunks = max_bytes / CHUNK_POOL_CHUNK_SIZE;
+    if (pool->max_chunks == 0)
+    {
+        pool->max_chunks = 1;
+    }
+    pool->allocated = 0;
+    pool->in_use = 0;
+    return pthread_mutex_init(&pool->lock, NULL);
+}
+
+void chunk_pool_destroy(struct chunk_pool *pool)
+{
+    while (pool->free_list)
+    {
+        struct chunk *chunk = pool->free_list;
+        pool->free_list = chunk->next;
+        free(chunk);
+    }
+    pthread_mutex_destroy(&pool->lock);
+}
+
+struct chunk *chunk_pool_get(struct chunk_pool *pool)
+{
+    struct chunk *chunk = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->free_list)
+    {
+        chunk = pool->free_list;
+        pool->free_list = chunk->next;
+    }
+    else if (pool->allocated < pool->max_chunks)
+    {
+        // count the chunk before dropping the lock so racing callers can't overshoot the cap
+        pool->allocated++;
+        pthread_mutex_unlock(&pool->lock);
+        chunk = malloc(sizeof(*chunk));
+        pthread_mutex_lock(&pool->lock);
+        if (!chunk)
+        {
+            pool->allocated--;
+        }
+    }
+    if (chunk)
+    {
+        pool->in_use++;
+        chunk->next = NULL;
+        chunk->len = 0;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return chunk;
+}
+
+void chunk_pool_put(struct chunk_pool *pool, struct chunk *chain)
+{
+    struct chunk *last = chain;
+    size_t count = 1;
+
+    if (!chain)
+    {
+        return;
+    }
+    // link the whole chain onto the free list with a single lock round trip
+    while (last->next)
+    {
+        last = last->next;
+        count++;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    last->next = pool->free_list;
+    pool->free_list = chain;
+    pool->in_use -= count;
+    pthread_mutex_unlock(&pool->lock);
+}
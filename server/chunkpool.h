@@ -0,0 +1,42 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026
+
+   Fixed size receive chunks shared by all connections.  Chunks freed by one connection
+   are handed to the next rather than returned to malloc, and the pool never holds more
+   than max_bytes in total, in use or free, so memory stays bounded however many clients
+   connect or how much they send. */
+
+#ifndef CHUNKPOOL_H
+#define CHUNKPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define CHUNK_POOL_CHUNK_SIZE 4096
+
+struct chunk {
+    struct chunk *next;  /* next chunk of the same packet, or of the free list */
+    size_t        len;   /* bytes used in data */
+    char          data[CHUNK_POOL_CHUNK_SIZE];
+};
+
+struct chunk_pool {
+    pthread_mutex_t lock;
+    struct chunk   *free_list;
+    size_t          max_chunks;  /* cap on chunks allocated */
+    size_t          allocated;   /* chunks allocated, in use or on the free list */
+    size_t          in_use;
+};
+
+int chunk_pool_init(struct chunk_pool *pool, size_t max_bytes);
+
+void chunk_pool_destroy(struct chunk_pool *pool);
+
+/* Take an empty chunk.  Returns NULL once max_bytes is in use, or on allocation failure. */
+struct chunk *chunk_pool_get(struct chunk_pool *pool);
+
+/* Return a chain of chunks linked through next */
+void chunk_pool_put(struct chunk_pool *pool, struct chunk *chain);
+
+#endif /* CHUNKPOOL_H */
@@ -0,0 +1,43 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026   */
+
+#include "packet.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct shared_packet *shared_packet_create(const struct iovec *iov, int iovcnt)
+{
+    struct shared_packet *packet;
+    size_t len = 0;
+    int idx;
+
+    for (idx = 0; idx < iovcnt; idx++)
+    {
+        len += iov[idx].iov_len;
+    }
+    packet = malloc(sizeof(*packet) + len);
+    if (!packet)
+    {
+        return NULL;
+    }
+
+    packet->refs = 1;
+    packet->len = 0;
+    for (idx = 0; idx < iovcnt; idx++)
+    {
+        memcpy(packet->data + packet->len, iov[idx].iov_base, iov[idx].iov_len);
+        packet->len += iov[idx].iov_len;
+    }
+    return packet;
+}
+
+void shared_packet_put(struct shared_packet *packet)
+{
+    // the release/acquire pair makes every user's accesses happen before the free
+    if (packet && (__atomic_sub_fetch(&packet->refs, 1, __ATOMIC_ACQ_REL) == 0))
+    {
+        free(packet);
+    }
+}
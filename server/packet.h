@@ -0,0 +1,35 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026
+
+   Reference counted copy of a committed packet.  commit_packet() makes one copy and
+   every consumer that outlives the commit (replication backlog, subscriber queues)
+   takes a reference instead of copying the payload again. */
+
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+struct shared_packet {
+    uint32_t refs;
+    size_t   len;
+    char     data[];
+};
+
+/* Copy the bytes described by iov into a new packet holding one reference.
+   Returns NULL on allocation failure. */
+struct shared_packet *shared_packet_create(const struct iovec *iov, int iovcnt);
+
+static inline struct shared_packet *shared_packet_get(struct shared_packet *packet)
+{
+    __atomic_add_fetch(&packet->refs, 1, __ATOMIC_RELAXED);
+    return packet;
+}
+
+/* Drop a reference, freeing the packet with the last one.  NULL is ignored. */
+void shared_packet_put(struct shared_packet *packet);
+
+#endif /* PACKET_H */
@@ -0,0 +1,897 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026   */
+
+#include "replication.h"
+#include "queue.h"
+#include "../aesd-char-driver/aesd-ring.h"
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REPL_MAGIC              "AESDREPL"
+#define REPL_MAGIC_LEN          8
+#define REPL_HELLO_LEN          (REPL_MAGIC_LEN + 8)
+#define REPL_HEADER_LEN         12
+#define REPL_RESYNC_LEN         UINT32_MAX
+#define REPL_BACKLOG_PACKETS    1024
+#define REPL_BATCH_BYTES        (64 * 1024)
+#define REPL_HELLO_TIMEOUT_S    5
+#define REPL_RETRY_S            1
+// Follow position on disk, fixed width so it is always overwritten in place
+#define REPL_STATE_FORMAT       "%020llu\n"
+#define REPL_STATE_LEN          21
+
+struct repl_packet {
+    uint64_t seq;
+    struct shared_packet *packet;   /* NULL for a packet lost to allocation failure */
+};
+
+static inline size_t repl_packet_len(const struct repl_packet *packet)
+{
+    return packet->packet ? packet->packet->len : 0;
+}
+
+// Packets held for followers, consecutive sequence numbers from the oldest
+AESD_RING_HEAD(repl_backlog, struct repl_packet, REPL_BACKLOG_PACKETS, uint16_t);
+
+struct repl_follower {
+    int       fd;
+    uint64_t  next_seq;         /* next packet to send */
+    uint64_t  acked_next;       /* one past the newest packet it acked */
+    bool      failed;
+    int       threads_running;  /* sender and ack reader, freed when both have exited */
+    SLIST_ENTRY(repl_follower) entries;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  published;  /* new packet, or a follower or stop needs the sender awake */
+    pthread_cond_t  acked;      /* a follower acked, failed or was freed */
+    bool            stopping;
+
+    // primary
+    bool            primary;
+    struct repl_backlog backlog;
+    size_t          backlog_bytes;
+    size_t          max_backlog_bytes;
+    uint64_t        next_seq;   /* one past the newest packet published */
+    enum repl_ack_level ack_level;
+    int             ack_timeout_ms;
+    int             listen_fd;
+    pthread_t       accept_thread;
+    SLIST_HEAD(repl_follower_list, repl_follower) followers;
+
+    // follower
+    bool            following;
+    pthread_t       follow_thread;
+    int             follow_fd;
+    char           *primary_host;
+    char           *primary_port;
+    uint64_t        follow_next_seq;
+    int             follow_state_fd;
+    repl_apply_fn   apply;
+} repl = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .published = PTHREAD_COND_INITIALIZER,
+    .acked = PTHREAD_COND_INITIALIZER,
+    .listen_fd = -1,
+    .follow_fd = -1,
+    .follow_state_fd = -1,
+};
+
+/* Leave SIGINT/SIGTERM to the accept loop and client threads */
+static void repl_block_signals(void)
+{
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+}
+
+static int repl_send_all(int fd, const void *buf, size_t len)
+{
+    const char *pos = buf;
+
+    while (len)
+    {
+        ssize_t sent = send(fd, pos, len, MSG_NOSIGNAL);
+        if (sent == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        pos += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+static int repl_recv_all(int fd, void *buf, size_t len)
+{
+    char *pos = buf;
+
+    while (len)
+    {
+        ssize_t received = recv(fd, pos, len, 0);
+        if (received == 0)
+        {
+            return -1;
+        }
+        if (received == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        pos += received;
+        len -= received;
+    }
+    return 0;
+}
+
+/* Tell a follower the primary cannot continue its log from where it asked, with a
+   frame carrying the oldest packet still held and REPL_RESYNC_LEN */
+static void repl_send_resync(int fd, uint64_t oldest)
+{
+    char frame[REPL_HEADER_LEN];
+    uint64_t seq_be = htobe64(oldest);
+    uint32_t len_be = htobe32(REPL_RESYNC_LEN);
+
+    memcpy(frame, &seq_be, sizeof(seq_be));
+    memcpy(frame + sizeof(seq_be), &len_be, sizeof(len_be));
+    repl_send_all(fd, frame, sizeof(frame));
+}
+
+/* Mark a follower connection dead and wake everything that may be waiting on it.
+   Called with repl.lock held. */
+static void repl_follower_fail(struct repl_follower *follower)
+{
+    if (!follower->failed)
+    {
+        follower->failed = true;
+        shutdown(follower->fd, SHUT_RDWR);
+        pthread_cond_broadcast(&repl.published);
+        pthread_cond_broadcast(&repl.acked);
+    }
+}
+
+/* Drop one thread's reference to a follower, freeing it after the last.
+   Called with repl.lock held. */
+static void repl_follower_put(struct repl_follower *follower)
+{
+    if (--follower->threads_running == 0)
+    {
+        SLIST_REMOVE(&repl.followers, follower, repl_follower, entries);
+        close(follower->fd);
+        free(follower);
+        pthread_cond_broadcast(&repl.acked);
+    }
+}
+
+/* Reads acks from one follower */
+static void *repl_acker(void *arg)
+{
+    struct repl_follower *follower = arg;
+    uint64_t ack_be;
+
+    repl_block_signals();
+    while (repl_recv_all(follower->fd, &ack_be, sizeof(ack_be)) == 0)
+    {
+        uint64_t ack = be64toh(ack_be);
+
+        pthread_mutex_lock(&repl.lock);
+        // ignore acks for packets never sent to this follower
+        if ((ack < follower->next_seq) && (ack + 1 > follower->acked_next))
+        {
+            follower->acked_next = ack + 1;
+            pthread_cond_broadcast(&repl.acked);
+        }
+        pthread_mutex_unlock(&repl.lock);
+    }
+
+    pthread_mutex_lock(&repl.lock);
+    repl_follower_fail(follower);
+    repl_follower_put(follower);
+    pthread_mutex_unlock(&repl.lock);
+    return NULL;
+}
+
+/* Read the follower's hello and start its ack reader.  The handshake runs on the
+   follower's own thread so a peer that stays silent holds up nobody else.
+   Returns 0, or -1 with the follower failed, either way with repl.lock held. */
+static int repl_follower_hello(struct repl_follower *follower)
+{
+    char hello[REPL_HELLO_LEN];
+    uint64_t from_seq_be;
+    struct timeval timeout = { .tv_sec = REPL_HELLO_TIMEOUT_S };
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    setsockopt(follower->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int ret = repl_recv_all(follower->fd, hello, sizeof(hello));
+    timeout.tv_sec = 0;
+    setsockopt(follower->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    pthread_mutex_lock(&repl.lock);
+    if (follower->failed || repl.stopping)
+    {
+        repl_follower_fail(follower);
+        return -1;
+    }
+    if ((ret != 0) || (memcmp(hello, REPL_MAGIC, REPL_MAGIC_LEN) != 0))
+    {
+        syslog(LOG_ERR, "Rejecting replication connection without hello");
+        repl_follower_fail(follower);
+        return -1;
+    }
+    memcpy(&from_seq_be, hello + REPL_MAGIC_LEN, sizeof(from_seq_be));
+    follower->next_seq = be64toh(from_seq_be);
+    syslog(LOG_INFO, "Follower connected from packet %llu, primary at %llu",
+           (unsigned long long)follower->next_seq, (unsigned long long)repl.next_seq);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    follower->threads_running++;
+    ret = pthread_create(&thread, &attr, repl_acker, follower);
+    pthread_attr_destroy(&attr);
+    if (ret != 0)
+    {
+        syslog(LOG_ERR, "Error creating replication ack reader");
+        follower->threads_running--;
+        repl_follower_fail(follower);
+        return -1;
+    }
+    return 0;
+}
+
+/* Streams backlog packets to one follower, batching everything pending into one send */
+static void *repl_sender(void *arg)
+{
+    struct repl_follower *follower = arg;
+    char  *batch = NULL;
+    size_t batch_cap = 0;
+
+    repl_block_signals();
+    if (repl_follower_hello(follower) != 0)
+    {
+        repl_follower_put(follower);
+        pthread_mutex_unlock(&repl.lock);
+        return NULL;
+    }
+    while (!repl.stopping && !follower->failed)
+    {
+        // a follower wanting packets the backlog no longer holds, or that were never
+        // published, does not share this log's history and has to be resynced by hand
+        uint64_t oldest = AESD_RING_EMPTY(&repl.backlog) ? repl.next_seq :
+                          AESD_RING_FIRST(&repl.backlog)->seq;
+        if ((follower->next_seq < oldest) || (follower->next_seq > repl.next_seq))
+        {
+            syslog(LOG_ERR, "Follower wants packet %llu, primary holds %llu to %llu, refusing it",
+                   (unsigned long long)follower->next_seq, (unsigned long long)oldest,
+                   (unsigned long long)repl.next_seq);
+            pthread_mutex_unlock(&repl.lock);
+            repl_send_resync(follower->fd, oldest);
+            pthread_mutex_lock(&repl.lock);
+            repl_follower_fail(follower);
+            break;
+        }
+        if (follower->next_seq == repl.next_seq)
+        {
+            pthread_cond_wait(&repl.published, &repl.lock);
+            continue;
+        }
+
+        // the batch is copied out so the backlog can move on while it is sent
+        size_t idx = follower->next_seq - oldest;
+        size_t count = AESD_RING_COUNT(&repl.backlog);
+        size_t batch_len = 0;
+        for (; idx < count; idx++)
+        {
+            struct repl_packet *packet = AESD_RING_AT(&repl.backlog, idx);
+            size_t packet_len = repl_packet_len(packet);
+            size_t frame_len = REPL_HEADER_LEN + packet_len;
+            uint64_t seq_be = htobe64(packet->seq);
+            uint32_t len_be = htobe32(packet_len);
+
+            if (batch_len && (batch_len + frame_len > REPL_BATCH_BYTES))
+            {
+                break;
+            }
+            if (batch_len + frame_len > batch_cap)
+            {
+                char *new_batch = realloc(batch, batch_len + frame_len);
+                if (!new_batch)
+                {
+                    break;
+                }
+                batch = new_batch;
+                batch_cap = batch_len + frame_len;
+            }
+            memcpy(batch + batch_len, &seq_be, sizeof(seq_be));
+            memcpy(batch + batch_len + sizeof(seq_be), &len_be, sizeof(len_be));
+            if (packet_len)
+            {
+                memcpy(batch + batch_len + REPL_HEADER_LEN, packet->packet->data, packet_len);
+            }
+            batch_len += frame_len;
+            follower->next_seq = packet->seq + 1;
+        }
+        if (!batch_len)
+        {
+            syslog(LOG_ERR, "Unable to allocate replication batch");
+            repl_follower_fail(follower);
+            break;
+        }
+
+        pthread_mutex_unlock(&repl.lock);
+        int ret = repl_send_all(follower->fd, batch, batch_len);
+        pthread_mutex_lock(&repl.lock);
+        if (ret != 0)
+        {
+            repl_follower_fail(follower);
+        }
+    }
+    repl_follower_fail(follower);
+    repl_follower_put(follower);
+    pthread_mutex_unlock(&repl.lock);
+
+    free(batch);
+    return NULL;
+}
+
+/* Start the sender for a new connection, which reads the hello and then starts the
+   ack reader.  Listed from the start so replication_stop() can cut it off.
+   Called with repl.lock held. */
+static void repl_follower_start(struct repl_follower *follower)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    SLIST_INSERT_HEAD(&repl.followers, follower, entries);
+    follower->threads_running = 1;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, repl_sender, follower) != 0)
+    {
+        syslog(LOG_ERR, "Error creating replication sender");
+        repl_follower_fail(follower);
+        repl_follower_put(follower);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+/* Accepts follower connections until replication stops */
+static void *repl_accept(void *arg)
+{
+    repl_block_signals();
+    while (true)
+    {
+        int fd = accept(repl.listen_fd, NULL, NULL);
+
+        pthread_mutex_lock(&repl.lock);
+        bool stopping = repl.stopping;
+        pthread_mutex_unlock(&repl.lock);
+        if (stopping)
+        {
+            if (fd != -1)
+            {
+                close(fd);
+            }
+            break;
+        }
+        if (fd == -1)
+        {
+            // back off on persistent errors such as running out of descriptors
+            if (errno != EINTR)
+            {
+                poll(NULL, 0, 100);
+            }
+            continue;
+        }
+
+        struct repl_follower *follower = calloc(1, sizeof(*follower));
+        if (!follower)
+        {
+            syslog(LOG_ERR, "Malloc failure");
+            close(fd);
+            continue;
+        }
+        follower->fd = fd;
+
+        pthread_mutex_lock(&repl.lock);
+        repl_follower_start(follower);
+        pthread_mutex_unlock(&repl.lock);
+    }
+    return NULL;
+}
+
+int replication_primary_start(const char *address, const char *port, uint64_t next_seq,
+                              enum repl_ack_level ack_level, size_t backlog_bytes, int ack_timeout_ms)
+{
+    struct addrinfo hints, *serv_info, *p;
+    int yes = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(address, port, &hints, &serv_info) != 0)
+    {
+        syslog(LOG_ERR, "Error getting replication address info");
+        return -1;
+    }
+    for (p = serv_info; p != NULL; p = p->ai_next)
+    {
+        repl.listen_fd = socket(p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol);
+        if (repl.listen_fd == -1)
+        {
+            continue;
+        }
+        if ((setsockopt(repl.listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == 0) &&
+            (bind(repl.listen_fd, p->ai_addr, p->ai_addrlen) == 0) &&
+            (listen(repl.listen_fd, 5) == 0))
+        {
+            break;
+        }
+        close(repl.listen_fd);
+        repl.listen_fd = -1;
+    }
+    freeaddrinfo(serv_info);
+    if (repl.listen_fd == -1)
+    {
+        syslog(LOG_ERR, "Error listening for followers on %s port %s", address, port);
+        return -1;
+    }
+
+    AESD_RING_INIT(&repl.backlog);
+    SLIST_INIT(&repl.followers);
+    repl.max_backlog_bytes = backlog_bytes;
+    repl.next_seq = next_seq;
+    repl.ack_level = ack_level;
+    repl.ack_timeout_ms = ack_timeout_ms;
+    repl.primary = true;
+    if (pthread_create(&repl.accept_thread, NULL, repl_accept, NULL) != 0)
+    {
+        syslog(LOG_ERR, "Error creating replication accept thread");
+        repl.primary = false;
+        close(repl.listen_fd);
+        repl.listen_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void replication_publish(uint64_t seq, struct shared_packet *packet)
+{
+    // keep sequence numbers consecutive in the backlog, followers count empty packets too
+    struct repl_packet entry = { .seq = seq, .packet = packet ? shared_packet_get(packet) : NULL };
+
+    if (!repl.primary)
+    {
+        shared_packet_put(entry.packet);
+        return;
+    }
+
+    pthread_mutex_lock(&repl.lock);
+    while (!AESD_RING_EMPTY(&repl.backlog) &&
+           (AESD_RING_FULL(&repl.backlog) ||
+            (repl.backlog_bytes + repl_packet_len(&entry) > repl.max_backlog_bytes)))
+    {
+        struct repl_packet *oldest = AESD_RING_FIRST(&repl.backlog);
+        repl.backlog_bytes -= repl_packet_len(oldest);
+        shared_packet_put(oldest->packet);
+        AESD_RING_POP(&repl.backlog);
+    }
+    AESD_RING_PUSH(&repl.backlog, entry);
+    repl.backlog_bytes += repl_packet_len(&entry);
+    repl.next_seq = seq + 1;
+    pthread_cond_broadcast(&repl.published);
+    pthread_mutex_unlock(&repl.lock);
+}
+
+/* Whether any follower has acked seq.  Called with repl.lock held. */
+static bool repl_acked(uint64_t seq)
+{
+    struct repl_follower *follower;
+
+    SLIST_FOREACH(follower, &repl.followers, entries)
+    {
+        if (follower->acked_next > seq)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void replication_wait(uint64_t seq)
+{
+    struct timespec deadline;
+
+    if (!repl.primary || (repl.ack_level == REPL_ACK_ASYNC))
+    {
+        return;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += repl.ack_timeout_ms / 1000;
+    deadline.tv_nsec += (long)(repl.ack_timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    // with no follower connected this waits out the timeout, one may yet connect and ack
+    pthread_mutex_lock(&repl.lock);
+    while (!repl_acked(seq) && !repl.stopping)
+    {
+        if (pthread_cond_timedwait(&repl.acked, &repl.lock, &deadline) == ETIMEDOUT)
+        {
+            syslog(LOG_WARNING, "No follower acked packet %llu within %d ms",
+                   (unsigned long long)seq, repl.ack_timeout_ms);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&repl.lock);
+}
+
+static int repl_connect(void)
+{
+    struct addrinfo hints, *serv_info, *p;
+    int fd = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(repl.primary_host, repl.primary_port, &hints, &serv_info) != 0)
+    {
+        return -1;
+    }
+    for (p = serv_info; p != NULL; p = p->ai_next)
+    {
+        fd = socket(p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol);
+        if (fd == -1)
+        {
+            continue;
+        }
+        if (connect(fd, p->ai_addr, p->ai_addrlen) == 0)
+        {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(serv_info);
+    return fd;
+}
+
+/* Record follow_next_seq so a restart carries on from it.  Returns 0 or -1. */
+static int repl_save_follow_seq(void)
+{
+    char state[REPL_STATE_LEN + 1];
+
+    snprintf(state, sizeof(state), REPL_STATE_FORMAT, (unsigned long long)repl.follow_next_seq);
+    if (pwrite(repl.follow_state_fd, state, REPL_STATE_LEN, 0) != REPL_STATE_LEN)
+    {
+        syslog(LOG_ERR, "Error saving follow position %llu", (unsigned long long)repl.follow_next_seq);
+        return -1;
+    }
+    return 0;
+}
+
+/* Apply packets from the primary until the connection drops.  Every packet that
+   arrived in one recv is applied before a single ack for the last of them is sent.
+   A packet that fails to apply ends the stream without being acked.  Returns 0 when
+   the connection should be retried, -1 when this log can no longer follow the primary. */
+static int repl_follow_stream(int fd, char **buf, size_t *buf_cap)
+{
+    size_t have = 0;
+
+    while (true)
+    {
+        size_t used = 0;
+        size_t needed = REPL_HEADER_LEN;
+        bool applied = false;
+        bool failed = false;
+        bool fatal = false;
+        uint64_t last_seq = 0;
+
+        ssize_t received = recv(fd, *buf + have, *buf_cap - have, 0);
+        if (received == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return 0;
+        }
+        have += received;
+
+        while (have - used >= REPL_HEADER_LEN)
+        {
+            uint64_t seq_be;
+            uint32_t len_be;
+
+            memcpy(&seq_be, *buf + used, sizeof(seq_be));
+            memcpy(&len_be, *buf + used + sizeof(seq_be), sizeof(len_be));
+            uint64_t seq = be64toh(seq_be);
+            size_t len = be32toh(len_be);
+
+            // applying anything past a gap would leave this log silently diverged
+            if ((len == REPL_RESYNC_LEN) || (seq > repl.follow_next_seq))
+            {
+                syslog(LOG_ERR, "Primary cannot continue from packet %llu (it holds from %llu), "
+                       "this follower needs a full resync", (unsigned long long)repl.follow_next_seq,
+                       (unsigned long long)seq);
+                fatal = true;
+                break;
+            }
+            if (have - used < REPL_HEADER_LEN + len)
+            {
+                needed = REPL_HEADER_LEN + len;
+                break;
+            }
+
+            // packets already applied are resent after a reconnect, skip them
+            if (seq == repl.follow_next_seq)
+            {
+                if (repl.apply(*buf + used + REPL_HEADER_LEN, len) != 0)
+                {
+                    // leave it unacked and reconnect, the primary resends from here
+                    syslog(LOG_ERR, "Error applying replicated packet %llu", (unsigned long long)seq);
+                    failed = true;
+                    break;
+                }
+                repl.follow_next_seq = seq + 1;
+                last_seq = seq;
+                applied = true;
+                if (repl_save_follow_seq() != 0)
+                {
+                    // applied but a restart would apply it again, stop before it grows
+                    fatal = true;
+                    break;
+                }
+            }
+            used += REPL_HEADER_LEN + len;
+        }
+
+        memmove(*buf, *buf + used, have - used);
+        have -= used;
+        if (needed > *buf_cap)
+        {
+            char *new_buf = realloc(*buf, needed);
+            if (!new_buf)
+            {
+                syslog(LOG_ERR, "Unable to allocate for replicated packet of %zu bytes", needed);
+                return 0;
+            }
+            *buf = new_buf;
+            *buf_cap = needed;
+        }
+
+        if (applied)
+        {
+            uint64_t ack_be = htobe64(last_seq);
+            if (repl_send_all(fd, &ack_be, sizeof(ack_be)) != 0)
+            {
+                return 0;
+            }
+        }
+        if (fatal)
+        {
+            return -1;
+        }
+        if (failed)
+        {
+            return 0;
+        }
+    }
+}
+
+/* Keeps a connection to the primary, reconnecting after failures */
+static void *repl_follow(void *arg)
+{
+    char   hello[REPL_HELLO_LEN];
+    size_t buf_cap = REPL_BATCH_BYTES;
+    char  *buf = malloc(buf_cap);
+    struct timespec retry;
+
+    repl_block_signals();
+    if (!buf)
+    {
+        syslog(LOG_ERR, "Malloc failure");
+        return NULL;
+    }
+
+    pthread_mutex_lock(&repl.lock);
+    while (!repl.stopping)
+    {
+        pthread_mutex_unlock(&repl.lock);
+        int fd = repl_connect();
+        pthread_mutex_lock(&repl.lock);
+
+        if ((fd == -1) || repl.stopping)
+        {
+            if (fd != -1)
+            {
+                close(fd);
+            }
+            // wait to retry, replication_stop() wakes us early
+            clock_gettime(CLOCK_REALTIME, &retry);
+            retry.tv_sec += REPL_RETRY_S;
+            pthread_cond_timedwait(&repl.published, &repl.lock, &retry);
+            continue;
+        }
+        repl.follow_fd = fd;
+        pthread_mutex_unlock(&repl.lock);
+
+        uint64_t from_seq_be = htobe64(repl.follow_next_seq);
+        memcpy(hello, REPL_MAGIC, REPL_MAGIC_LEN);
+        memcpy(hello + REPL_MAGIC_LEN, &from_seq_be, sizeof(from_seq_be));
+        syslog(LOG_INFO, "Following %s:%s from packet %llu", repl.primary_host, repl.primary_port,
+               (unsigned long long)repl.follow_next_seq);
+        int ret = 0;
+        if (repl_send_all(fd, hello, sizeof(hello)) == 0)
+        {
+            ret = repl_follow_stream(fd, &buf, &buf_cap);
+        }
+
+        pthread_mutex_lock(&repl.lock);
+        repl.follow_fd = -1;
+        close(fd);
+        if (ret != 0)
+        {
+            syslog(LOG_ERR, "Stopped following %s:%s at packet %llu", repl.primary_host, repl.primary_port,
+                   (unsigned long long)repl.follow_next_seq);
+            break;
+        }
+        syslog(LOG_INFO, "Lost connection to primary at packet %llu", (unsigned long long)repl.follow_next_seq);
+    }
+    pthread_mutex_unlock(&repl.lock);
+
+    free(buf);
+    return NULL;
+}
+
+uint64_t replication_follower_saved_seq(const char *state_path)
+{
+    char state[REPL_STATE_LEN + 1];
+    ssize_t len;
+    int fd = open(state_path, O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1)
+    {
+        return 0;
+    }
+    len = pread(fd, state, REPL_STATE_LEN, 0);
+    close(fd);
+    if (len <= 0)
+    {
+        return 0;
+    }
+    state[len] = '\0';
+    return strtoull(state, NULL, 10);
+}
+
+int replication_follower_start(const char *primary, uint64_t from_seq, const char *state_path,
+                               repl_apply_fn apply)
+{
+    const char *colon = strrchr(primary, ':');
+
+    if (!colon || (colon == primary) || !colon[1])
+    {
+        syslog(LOG_ERR, "Primary must be given as host:port, got %s", primary);
+        return -1;
+    }
+    repl.primary_host = strndup(primary, colon - primary);
+    repl.primary_port = strdup(colon + 1);
+    if (!repl.primary_host || !repl.primary_port)
+    {
+        free(repl.primary_host);
+        free(repl.primary_port);
+        return -1;
+    }
+    repl.follow_next_seq = from_seq;
+    repl.apply = apply;
+    repl.follow_state_fd = open(state_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if ((repl.follow_state_fd == -1) || (repl_save_follow_seq() != 0))
+    {
+        syslog(LOG_ERR, "Error opening follow position file %s", state_path);
+        goto fail;
+    }
+    if (pthread_create(&repl.follow_thread, NULL, repl_follow, NULL) != 0)
+    {
+        syslog(LOG_ERR, "Error creating replication follower thread");
+        goto fail;
+    }
+    repl.following = true;
+    return 0;
+
+fail:
+    if (repl.follow_state_fd != -1)
+    {
+        close(repl.follow_state_fd);
+        repl.follow_state_fd = -1;
+    }
+    free(repl.primary_host);
+    free(repl.primary_port);
+    return -1;
+}
+
+void replication_stop(void)
+{
+    struct repl_follower *follower;
+
+    pthread_mutex_lock(&repl.lock);
+    repl.stopping = true;
+    pthread_cond_broadcast(&repl.published);
+    pthread_cond_broadcast(&repl.acked);
+    if (repl.follow_fd != -1)
+    {
+        shutdown(repl.follow_fd, SHUT_RDWR);
+    }
+    if (repl.listen_fd != -1)
+    {
+        shutdown(repl.listen_fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&repl.lock);
+
+    if (repl.following)
+    {
+        pthread_join(repl.follow_thread, NULL);
+        free(repl.primary_host);
+        free(repl.primary_port);
+        close(repl.follow_state_fd);
+        repl.follow_state_fd = -1;
+        repl.following = false;
+    }
+    if (!repl.primary)
+    {
+        return;
+    }
+
+    pthread_join(repl.accept_thread, NULL);
+    close(repl.listen_fd);
+    repl.listen_fd = -1;
+
+    // cut off every follower and wait for their threads to let go of them
+    pthread_mutex_lock(&repl.lock);
+    SLIST_FOREACH(follower, &repl.followers, entries)
+    {
+        repl_follower_fail(follower);
+    }
+    while (!SLIST_EMPTY(&repl.followers))
+    {
+        pthread_cond_wait(&repl.acked, &repl.lock);
+    }
+    while (!AESD_RING_EMPTY(&repl.backlog))
+    {
+        shared_packet_put(AESD_RING_FIRST(&repl.backlog)->packet);
+        AESD_RING_POP(&repl.backlog);
+    }
+    repl.backlog_bytes = 0;
+    repl.primary = false;
+    pthread_mutex_unlock(&repl.lock);
+}
@@ -0,0 +1,80 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026
+
+   Log replication between aesdsocket instances.
+
+   A primary listens for followers on a separate port and streams every committed
+   packet to them, tagged with its sequence number.  Recent packets are kept in a
+   bounded backlog so a follower can (re)connect and catch up from any sequence number
+   still held.  A follower asking for a packet older than the backlog, or newer than
+   anything published, is sent a resync frame and cut off; it stops following rather
+   than apply anything across the gap, and has to be resynced by hand.  Each follower gets its own sender, which batches whatever is pending
+   into one send, and its own ack reader, so a slow follower never delays the append
+   path or the other followers.
+
+   There is no authentication or encryption: anyone who can reach the replication port
+   can read the whole log, and a follower applies whatever its primary sends.  The
+   listener binds only the address it is given, and should only be exposed on a
+   network where every host is trusted.
+
+   Wire format, all integers big endian:
+     follower -> primary  hello  "AESDREPL" u64 first sequence number wanted
+     primary  -> follower packet u64 sequence number, u32 length, payload
+     primary  -> follower resync u64 oldest sequence number held, u32 0xffffffff
+     follower -> primary  ack    u64 sequence number of the last packet applied
+
+   With REPL_ACK_ONE the committing thread waits until at least one follower has acked
+   its packet, or the ack timeout passes, before answering its client.  Acks are tracked
+   per follower, and with no follower connected every commit waits out the timeout. */
+
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "packet.h"
+
+enum repl_ack_level {
+    REPL_ACK_ASYNC,     /* commit returns as soon as the packet is queued */
+    REPL_ACK_ONE,       /* commit waits for one follower to ack */
+};
+
+/* Applies one replicated packet on a follower, returns 0 on success.  len is 0 for a
+   packet the primary failed to write, which still takes its sequence number. */
+typedef int (*repl_apply_fn)(const char *data, size_t len);
+
+/* Start serving followers on address and port, next_seq being the first packet to be
+   published.  backlog_bytes bounds the packets kept for
+   catch-up. */
+int replication_primary_start(const char *address, const char *port, uint64_t next_seq,
+                              enum repl_ack_level ack_level, size_t backlog_bytes, int ack_timeout_ms);
+
+/* Queue packet seq for the followers, taking a reference to packet.  NULL stands for a
+   packet that could not be allocated or written and is replicated as empty.  Called with the log
+   lock held, so packets are published in sequence order.  Does nothing unless running
+   as a primary. */
+void replication_publish(uint64_t seq, struct shared_packet *packet);
+
+/* Block until seq is acked as the ack level requires.  Call without the log lock. */
+void replication_wait(uint64_t seq);
+
+/* Sequence number a follower saved to state_path, 0 when there is none */
+uint64_t replication_follower_saved_seq(const char *state_path);
+
+/* Follow the primary at host:port, starting from sequence number from_seq and
+   reconnecting whenever the connection drops.  The next packet wanted is kept in
+   state_path after every packet applied, see replication_follower_saved_seq().
+   Packets, empty ones included, are passed to apply in order;
+   if apply fails nothing more is acked and the connection is dropped, so the primary
+   resends from that packet.  If the primary can no longer continue from the packet
+   wanted the follower logs it and stops.  The caller must not commit writes of its own
+   meanwhile. */
+int replication_follower_start(const char *primary, uint64_t from_seq, const char *state_path,
+                               repl_apply_fn apply);
+
+/* Stop all replication threads and release the backlog */
+void replication_stop(void);
+
+#endif /* REPLICATION_H */
@@ -0,0 +1,463 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026   */
+
+#include "segment.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define SEGMENT_IO_BYTES        (64 * 1024)
+// Sealing happens once per segment, so spend the CPU on ratio.  Readback of the live
+// file is deflated per request, so favour speed there.
+#define SEGMENT_SEAL_LEVEL      Z_BEST_COMPRESSION
+#define SEGMENT_STREAM_LEVEL    Z_BEST_SPEED
+#define GZIP_WINDOW_BITS        (15 + 16)   /* write a gzip header and trailer */
+#define GUNZIP_WINDOW_BITS      (15 + 32)   /* accept gzip or zlib */
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  sealed_cond;
+    const char     *log_file;
+    size_t          segment_bytes;
+    unsigned int    sealed;         /* segments 0 .. sealed - 1 exist */
+    unsigned int    compressed;     /* segments below this are gzipped */
+    bool            stopping;
+    bool            running;
+    pthread_t       thread;
+} seg = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .sealed_cond = PTHREAD_COND_INITIALIZER,
+};
+
+#define SEGMENT_RAW ""
+#define SEGMENT_GZ  ".gz"
+#define SEGMENT_TMP ".gz.tmp"
+
+static void segment_path(char *buf, size_t size, unsigned int idx, const char *suffix)
+{
+    snprintf(buf, size, "%s.%u%s", seg.log_file, idx, suffix);
+}
+
+/* Open a sealed segment, preferring whichever form the caller wants.  The compressor
+   writes the .gz before removing the raw file, so one of them always exists. */
+static int segment_open(unsigned int idx, bool prefer_gz, bool *is_gz)
+{
+    char path[PATH_MAX];
+    bool order[3] = { prefer_gz, !prefer_gz, prefer_gz };
+    int attempt;
+
+    for (attempt = 0; attempt < 3; attempt++)
+    {
+        segment_path(path, sizeof(path), idx, order[attempt] ? SEGMENT_GZ : SEGMENT_RAW);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd != -1)
+        {
+            *is_gz = order[attempt];
+            return fd;
+        }
+    }
+    syslog(LOG_ERR, "Log segment %u is missing", idx);
+    return -1;
+}
+
+/* Deflate in_fd to EOF as one gzip member, handing each block of output to out */
+static int segment_deflate(int in_fd, int level, segment_send_fn out, void *out_arg)
+{
+    z_stream strm = { 0 };
+    char *in = malloc(SEGMENT_IO_BYTES);
+    char *buf = malloc(SEGMENT_IO_BYTES);
+    int retval = -1;
+    int flush = Z_NO_FLUSH;
+
+    if (!in || !buf || (deflateInit2(&strm, level, Z_DEFLATED, GZIP_WINDOW_BITS, 8,
+                                     Z_DEFAULT_STRATEGY) != Z_OK))
+    {
+        syslog(LOG_ERR, "Unable to set up compression");
+        free(in);
+        free(buf);
+        return -1;
+    }
+    while (flush != Z_FINISH)
+    {
+        ssize_t len = read(in_fd, in, SEGMENT_IO_BYTES);
+        if (len == -1)
+        {
+            syslog(LOG_ERR, "Error reading log for compression");
+            goto done;
+        }
+        flush = (len == 0) ? Z_FINISH : Z_NO_FLUSH;
+        strm.next_in = (Bytef *)in;
+        strm.avail_in = len;
+        do
+        {
+            strm.next_out = (Bytef *)buf;
+            strm.avail_out = SEGMENT_IO_BYTES;
+            deflate(&strm, flush);
+            size_t have = SEGMENT_IO_BYTES - strm.avail_out;
+            if (have && (out(out_arg, buf, have) != 0))
+            {
+                goto done;
+            }
+        } while (strm.avail_out == 0);
+    }
+    retval = 0;
+
+done:
+    deflateEnd(&strm);
+    free(in);
+    free(buf);
+    return retval;
+}
+
+/* Inflate in_fd to EOF, which may hold several gzip members, handing output to out */
+static int segment_inflate(int in_fd, segment_send_fn out, void *out_arg)
+{
+    z_stream strm = { 0 };
+    char *in = malloc(SEGMENT_IO_BYTES);
+    char *buf = malloc(SEGMENT_IO_BYTES);
+    int retval = -1;
+    int ret = Z_OK;
+    bool member_ended = false;
+
+    if (!in || !buf || (inflateInit2(&strm, GUNZIP_WINDOW_BITS) != Z_OK))
+    {
+        syslog(LOG_ERR, "Unable to set up decompression");
+        free(in);
+        free(buf);
+        return -1;
+    }
+    for (;;)
+    {
+        ssize_t len = read(in_fd, in, SEGMENT_IO_BYTES);
+        if (len == -1)
+        {
+            syslog(LOG_ERR, "Error reading log segment");
+            goto done;
+        }
+        if (len == 0)
+        {
+            break;
+        }
+        strm.next_in = (Bytef *)in;
+        strm.avail_in = len;
+        // a full output buffer may leave more pending even once the input is used up
+        do
+        {
+            strm.next_out = (Bytef *)buf;
+            strm.avail_out = SEGMENT_IO_BYTES;
+            ret = inflate(&strm, Z_NO_FLUSH);
+            if ((ret != Z_OK) && (ret != Z_STREAM_END) && (ret != Z_BUF_ERROR))
+            {
+                syslog(LOG_ERR, "Corrupt log segment");
+                goto done;
+            }
+            size_t have = SEGMENT_IO_BYTES - strm.avail_out;
+            if (have && (out(out_arg, buf, have) != 0))
+            {
+                goto done;
+            }
+            // Z_BUF_ERROR only means more input is needed, it says nothing about the member
+            if (ret != Z_BUF_ERROR)
+            {
+                member_ended = (ret == Z_STREAM_END);
+            }
+            // another member may follow
+            if (ret == Z_STREAM_END)
+            {
+                inflateReset(&strm);
+            }
+        } while (strm.avail_in || (strm.avail_out == 0));
+    }
+
+    // a segment cut short ends in the middle of a member
+    if (!member_ended)
+    {
+        syslog(LOG_ERR, "Truncated log segment");
+        goto done;
+    }
+    retval = 0;
+
+done:
+    inflateEnd(&strm);
+    free(in);
+    free(buf);
+    return retval;
+}
+
+/* Hand in_fd to out as it is */
+static int segment_copy(int in_fd, segment_send_fn out, void *out_arg)
+{
+    char *buf = malloc(SEGMENT_IO_BYTES);
+    ssize_t len;
+    int retval = 0;
+
+    if (!buf)
+    {
+        return -1;
+    }
+    while ((len = read(in_fd, buf, SEGMENT_IO_BYTES)) > 0)
+    {
+        if (out(out_arg, buf, len) != 0)
+        {
+            retval = -1;
+            break;
+        }
+    }
+    if (len == -1)
+    {
+        retval = -1;
+    }
+    free(buf);
+    return retval;
+}
+
+static int segment_write_fd(void *arg, const char *buf, size_t len)
+{
+    int fd = *(int *)arg;
+
+    while (len)
+    {
+        ssize_t written = write(fd, buf, len);
+        if (written == -1)
+        {
+            return -1;
+        }
+        buf += written;
+        len -= written;
+    }
+    return 0;
+}
+
+/* Gzip one sealed segment next to the raw file, then swap it in */
+static int segment_compress(unsigned int idx)
+{
+    char raw_path[PATH_MAX];
+    char gz_path[PATH_MAX];
+    char tmp_path[PATH_MAX];
+    int retval = -1;
+
+    segment_path(raw_path, sizeof(raw_path), idx, SEGMENT_RAW);
+    segment_path(gz_path, sizeof(gz_path), idx, SEGMENT_GZ);
+    segment_path(tmp_path, sizeof(tmp_path), idx, SEGMENT_TMP);
+
+    int raw_fd = open(raw_path, O_RDONLY | O_CLOEXEC);
+    if (raw_fd == -1)
+    {
+        // compressed already, before a restart
+        return (access(gz_path, R_OK) == 0) ? 0 : -1;
+    }
+    int gz_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (gz_fd == -1)
+    {
+        syslog(LOG_ERR, "Error creating %s", tmp_path);
+        close(raw_fd);
+        return -1;
+    }
+    if ((segment_deflate(raw_fd, SEGMENT_SEAL_LEVEL, segment_write_fd, &gz_fd) == 0) &&
+        (fsync(gz_fd) == 0))
+    {
+        retval = 0;
+    }
+    close(gz_fd);
+    close(raw_fd);
+
+    // the .gz has to exist before the raw file goes, readers fall back from one to the other
+    if ((retval == 0) && (rename(tmp_path, gz_path) == 0))
+    {
+        unlink(raw_path);
+    }
+    else
+    {
+        syslog(LOG_ERR, "Error compressing log segment %u", idx);
+        unlink(tmp_path);
+        retval = -1;
+    }
+    return retval;
+}
+
+static void *segment_compressor(void *arg)
+{
+    sigset_t mask;
+
+    // leave SIGINT/SIGTERM to the accept loop
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    pthread_mutex_lock(&seg.lock);
+    while (!seg.stopping)
+    {
+        if (seg.compressed == seg.sealed)
+        {
+            pthread_cond_wait(&seg.sealed_cond, &seg.lock);
+            continue;
+        }
+        unsigned int idx = seg.compressed;
+        pthread_mutex_unlock(&seg.lock);
+        int ret = segment_compress(idx);
+        pthread_mutex_lock(&seg.lock);
+        // a segment that fails stays raw, which readers handle, rather than blocking the rest
+        seg.compressed = idx + 1;
+        if (ret == 0)
+        {
+            syslog(LOG_INFO, "Compressed log segment %u", idx);
+        }
+    }
+    pthread_mutex_unlock(&seg.lock);
+    return NULL;
+}
+
+int segment_init(const char *log_file, size_t segment_bytes)
+{
+    char raw_path[PATH_MAX];
+    char gz_path[PATH_MAX];
+
+    seg.log_file = log_file;
+    seg.segment_bytes = segment_bytes;
+
+    // segments are numbered from 0 without gaps, carry on after the last one
+    for (;;)
+    {
+        segment_path(raw_path, sizeof(raw_path), seg.sealed, SEGMENT_RAW);
+        segment_path(gz_path, sizeof(gz_path), seg.sealed, SEGMENT_GZ);
+        if ((access(raw_path, F_OK) != 0) && (access(gz_path, F_OK) != 0))
+        {
+            break;
+        }
+        seg.sealed++;
+    }
+    if (seg.sealed)
+    {
+        syslog(LOG_INFO, "Found %u log segments", seg.sealed);
+    }
+
+    // nothing new is ever sealed without a size, so there is nothing to compress
+    if (segment_bytes == 0)
+    {
+        return 0;
+    }
+
+    // the compressor skips segments already gzipped, so start it from the beginning
+    if (pthread_create(&seg.thread, NULL, segment_compressor, NULL) != 0)
+    {
+        syslog(LOG_ERR, "Error creating compressor thread");
+        return -1;
+    }
+    seg.running = true;
+    return 0;
+}
+
+void segment_after_write(int fd)
+{
+    char path[PATH_MAX];
+    struct stat st;
+
+    if ((seg.segment_bytes == 0) || (fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) ||
+        ((size_t)st.st_size < seg.segment_bytes))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&seg.lock);
+    segment_path(path, sizeof(path), seg.sealed, SEGMENT_RAW);
+    if (rename(seg.log_file, path) == 0)
+    {
+        seg.sealed++;
+        pthread_cond_signal(&seg.sealed_cond);
+    }
+    else
+    {
+        syslog(LOG_ERR, "Error sealing log segment %u", seg.sealed);
+    }
+    pthread_mutex_unlock(&seg.lock);
+
+    // readers open the live file by name, so it must never be missing
+    int new_fd = open(seg.log_file, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (new_fd != -1)
+    {
+        close(new_fd);
+    }
+}
+
+unsigned int segment_count(void)
+{
+    unsigned int count;
+
+    pthread_mutex_lock(&seg.lock);
+    count = seg.sealed;
+    pthread_mutex_unlock(&seg.lock);
+    return count;
+}
+
+int segment_send(unsigned int count, bool gzip, segment_send_fn send_fn, void *send_arg)
+{
+    unsigned int idx;
+
+    for (idx = 0; idx < count; idx++)
+    {
+        bool is_gz;
+        int ret;
+        int fd = segment_open(idx, gzip, &is_gz);
+        if (fd == -1)
+        {
+            return -1;
+        }
+        if (gzip == is_gz)
+        {
+            // stored members, or raw bytes for a plain reader, go out untouched
+            ret = segment_copy(fd, send_fn, send_arg);
+        }
+        else if (gzip)
+        {
+            ret = segment_deflate(fd, SEGMENT_STREAM_LEVEL, send_fn, send_arg);
+        }
+        else
+        {
+            ret = segment_inflate(fd, send_fn, send_arg);
+        }
+        close(fd);
+        if (ret != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int segment_send_gzip_fd(int fd, segment_send_fn send_fn, void *send_arg)
+{
+    return segment_deflate(fd, SEGMENT_STREAM_LEVEL, send_fn, send_arg);
+}
+
+void segment_stop(bool remove_files)
+{
+    char path[PATH_MAX];
+    unsigned int idx;
+
+    if (seg.running)
+    {
+        pthread_mutex_lock(&seg.lock);
+        seg.stopping = true;
+        pthread_cond_signal(&seg.sealed_cond);
+        pthread_mutex_unlock(&seg.lock);
+        pthread_join(seg.thread, NULL);
+        seg.running = false;
+    }
+    for (idx = 0; remove_files && (idx < seg.sealed); idx++)
+    {
+        segment_path(path, sizeof(path), idx, SEGMENT_RAW);
+        unlink(path);
+        segment_path(path, sizeof(path), idx, SEGMENT_GZ);
+        unlink(path);
+    }
+}
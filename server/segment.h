@@ -0,0 +1,52 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026
+
+   Sealed, compressed log segments and compressed readback, built in with
+   make COMPRESS=1.
+
+   Once a regular log file reaches segment_bytes it is sealed: renamed to
+   LOG_FILE.<n> under the log lock and replaced with an empty file.  A background
+   thread then gzips each sealed segment to LOG_FILE.<n>.gz and removes the raw copy,
+   so compression never holds up a commit.  The full log is the sealed segments in
+   order followed by the live file.
+
+   Readback can be asked for as gzip.  Sealed segments are stored as gzip members and
+   members concatenate into a valid gzip stream, so they go out exactly as stored and
+   only the live file, or a segment not yet compressed, is deflated on the fly.
+   Segments are only inflated for clients that read back uncompressed. */
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Packet asking for the whole log back as a gzip stream, nothing is committed
+#define SEGMENT_GZIP_COMMAND "AESDSOCKET_READ_GZIP\n"
+
+/* Sends all of buf to the client, returns 0 or -1 */
+typedef int (*segment_send_fn)(void *arg, const char *buf, size_t len);
+
+/* Pick up segments left by an earlier run and start the compressor.  segment_bytes of
+   0 never seals and starts no thread, leaving only compressed readback.  Returns 0 or -1. */
+int segment_init(const char *log_file, size_t segment_bytes);
+
+/* Seal the live file if fd, open on it, has reached the segment size.  Called with the
+   log lock held, straight after a write. */
+void segment_after_write(int fd);
+
+/* Number of sealed segments.  Call with the log lock held and open the live file under
+   the same hold to get a consistent view of the log. */
+unsigned int segment_count(void);
+
+/* Send the first count sealed segments, as gzip members or inflated.  Returns 0 or -1. */
+int segment_send(unsigned int count, bool gzip, segment_send_fn send_fn, void *send_arg);
+
+/* Send fd from its current offset to EOF as one gzip member.  Returns 0 or -1. */
+int segment_send_gzip_fd(int fd, segment_send_fn send_fn, void *send_arg);
+
+/* Stop the compressor, removing every segment file as well when remove_files is set */
+void segment_stop(bool remove_files);
+
+#endif /* SEGMENT_H */
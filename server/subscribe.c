@@ -0,0 +1,223 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026   */
+
+// POLLRDHUP is a GNU extension
+#define _GNU_SOURCE
+
+#include "subscribe.h"
+#include "queue.h"
+#include "../aesd-char-driver/aesd-ring.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <syslog.h>
+#include <time.h>
+
+#define SUBSCRIBE_POLL_S 1
+
+AESD_RING_HEAD(subscribe_queue, struct shared_packet *, SUBSCRIBE_QUEUE_PACKETS, uint8_t);
+
+struct subscriber {
+    int       fd;
+    bool      dropped;      /* fell behind under SUBSCRIBE_DROP */
+    uint64_t  skipped;      /* packets discarded under SUBSCRIBE_SKIP */
+    pthread_cond_t ready;   /* queue gained a packet, or the subscriber must leave */
+    struct subscribe_queue queue;
+    SLIST_ENTRY(subscriber) entries;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    enum subscribe_policy policy;
+    bool            stopping;
+    unsigned int    count;  /* read without the lock by subscribe_active() */
+    SLIST_HEAD(subscriber_list, subscriber) subscribers;
+} subs = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+void subscribe_init(enum subscribe_policy policy)
+{
+    subs.policy = policy;
+    SLIST_INIT(&subs.subscribers);
+}
+
+bool subscribe_active(void)
+{
+    return __atomic_load_n(&subs.count, __ATOMIC_RELAXED) != 0;
+}
+
+void subscribe_publish(struct shared_packet *packet)
+{
+    struct subscriber *sub;
+
+    if (!packet || !subscribe_active())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&subs.lock);
+    SLIST_FOREACH(sub, &subs.subscribers, entries)
+    {
+        if (sub->dropped)
+        {
+            continue;
+        }
+        if (AESD_RING_FULL(&sub->queue))
+        {
+            if (subs.policy == SUBSCRIBE_DROP)
+            {
+                // wake the sender out of a blocked send as well as its wait
+                sub->dropped = true;
+                shutdown(sub->fd, SHUT_RDWR);
+                pthread_cond_signal(&sub->ready);
+                continue;
+            }
+            shared_packet_put(*AESD_RING_FIRST(&sub->queue));
+            AESD_RING_POP(&sub->queue);
+            sub->skipped++;
+        }
+        AESD_RING_PUSH(&sub->queue, shared_packet_get(packet));
+        pthread_cond_signal(&sub->ready);
+    }
+    pthread_mutex_unlock(&subs.lock);
+}
+
+static int subscribe_send_all(int fd, const char *buf, size_t len)
+{
+    while (len)
+    {
+        ssize_t sent = send(fd, buf, len, MSG_NOSIGNAL);
+        if (sent == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        buf += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+/* Anything a subscriber sends is ignored, only its disconnect matters.  Nothing is read,
+   so this works the same on TLS connections, whose records only the TLS layer may consume. */
+static bool subscribe_peer_closed(int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLRDHUP };
+
+    if (poll(&pfd, 1, 0) == -1)
+    {
+        return errno != EINTR;
+    }
+    return (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL)) != 0;
+}
+
+int subscribe_serve(int client_fd, subscribe_send_fn send_fn, void *send_arg)
+{
+    struct subscriber *sub = calloc(1, sizeof(*sub));
+    pthread_condattr_t attr;
+
+    if (!sub)
+    {
+        syslog(LOG_ERR, "Unable to allocate subscriber");
+        return -1;
+    }
+    sub->fd = client_fd;
+    AESD_RING_INIT(&sub->queue);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sub->ready, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_mutex_lock(&subs.lock);
+    if (subs.stopping)
+    {
+        pthread_mutex_unlock(&subs.lock);
+        pthread_cond_destroy(&sub->ready);
+        free(sub);
+        return 0;
+    }
+    SLIST_INSERT_HEAD(&subs.subscribers, sub, entries);
+    __atomic_add_fetch(&subs.count, 1, __ATOMIC_RELAXED);
+
+    while (!subs.stopping && !sub->dropped)
+    {
+        if (AESD_RING_EMPTY(&sub->queue))
+        {
+            struct timespec deadline;
+
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += SUBSCRIBE_POLL_S;
+            if ((pthread_cond_timedwait(&sub->ready, &subs.lock, &deadline) == ETIMEDOUT) &&
+                AESD_RING_EMPTY(&sub->queue))
+            {
+                // nothing to send for a while, check the subscriber is still there
+                pthread_mutex_unlock(&subs.lock);
+                bool closed = subscribe_peer_closed(client_fd);
+                pthread_mutex_lock(&subs.lock);
+                if (closed)
+                {
+                    break;
+                }
+            }
+            continue;
+        }
+
+        // send outside the lock, the reference keeps the packet alive
+        struct shared_packet *packet = *AESD_RING_FIRST(&sub->queue);
+        AESD_RING_POP(&sub->queue);
+        pthread_mutex_unlock(&subs.lock);
+        int ret = send_fn ? send_fn(send_arg, packet->data, packet->len)
+                          : subscribe_send_all(client_fd, packet->data, packet->len);
+        shared_packet_put(packet);
+        pthread_mutex_lock(&subs.lock);
+        if (ret != 0)
+        {
+            break;
+        }
+    }
+
+    SLIST_REMOVE(&subs.subscribers, sub, subscriber, entries);
+    __atomic_sub_fetch(&subs.count, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&subs.lock);
+
+    if (sub->dropped)
+    {
+        syslog(LOG_WARNING, "Dropped subscriber that fell %d packets behind", SUBSCRIBE_QUEUE_PACKETS);
+    }
+    if (sub->skipped)
+    {
+        syslog(LOG_WARNING, "Subscriber skipped %llu packets", (unsigned long long)sub->skipped);
+    }
+    while (!AESD_RING_EMPTY(&sub->queue))
+    {
+        shared_packet_put(*AESD_RING_FIRST(&sub->queue));
+        AESD_RING_POP(&sub->queue);
+    }
+    pthread_cond_destroy(&sub->ready);
+    free(sub);
+
+    return 0;
+}
+
+void subscribe_stop(void)
+{
+    struct subscriber *sub;
+
+    pthread_mutex_lock(&subs.lock);
+    subs.stopping = true;
+    SLIST_FOREACH(sub, &subs.subscribers, entries)
+    {
+        shutdown(sub->fd, SHUT_RDWR);
+        pthread_cond_signal(&sub->ready);
+    }
+    pthread_mutex_unlock(&subs.lock);
+}
@@ -0,0 +1,49 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026
+
+   Live subscribers.  A client that sends AESDSOCKET_SUBSCRIBE as its packet keeps its
+   connection open and is pushed every packet committed after it, in commit order.
+   Each subscriber has a small bounded queue of references to the shared packet, so
+   fan-out never copies the payload and committing never waits on a subscriber.  When
+   a subscriber's queue is full the policy decides what gives: SUBSCRIBE_DROP closes
+   the subscriber, SUBSCRIBE_SKIP discards its oldest queued packet and counts it. */
+
+#ifndef SUBSCRIBE_H
+#define SUBSCRIBE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "packet.h"
+
+#define SUBSCRIBE_COMMAND       "AESDSOCKET_SUBSCRIBE\n"
+#define SUBSCRIBE_QUEUE_PACKETS 64
+
+enum subscribe_policy {
+    SUBSCRIBE_DROP,     /* disconnect a subscriber that falls a full queue behind */
+    SUBSCRIBE_SKIP,     /* keep the subscriber, discarding the oldest packets it missed */
+};
+
+void subscribe_init(enum subscribe_policy policy);
+
+/* True while any subscriber is connected, so commits can skip building a shared packet */
+bool subscribe_active(void);
+
+/* Queue packet for every subscriber, taking a reference per subscriber.  Called with
+   the log lock held so subscribers see packets in commit order. */
+void subscribe_publish(struct shared_packet *packet);
+
+/* Sends all of buf to a subscriber, returns 0 or -1 */
+typedef int (*subscribe_send_fn)(void *arg, const char *buf, size_t len);
+
+/* Serve client_fd as a subscriber until it disconnects, is dropped or subscribe_stop()
+   is called.  Packets go out through send_fn when given, for connections wrapped in
+   TLS, otherwise straight to the socket.  A failed send just ends the subscription, so
+   this returns 0 once the subscriber is gone, whatever the reason, and -1 only if it
+   could not be registered. */
+int subscribe_serve(int client_fd, subscribe_send_fn send_fn, void *send_arg);
+
+/* Disconnect every subscriber and refuse new ones */
+void subscribe_stop(void);
+
+#endif /* SUBSCRIBE_H */
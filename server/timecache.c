@@ -0,0 +1,92 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026   */
+
+#include "timecache.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+void timecache_init(struct timecache *cache, const char *format)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->sec = (time_t)-1;
+    cache->format = format;
+}
+
+/* Reformat the cache for sec.  Only the caller that moves seq from even to odd does the
+   work, anyone racing it goes back to reading and waits out the odd sequence. */
+static void timecache_refresh(struct timecache *cache, uint32_t seq, time_t sec)
+{
+    struct tm tm;
+    size_t len = 0;
+
+    if (!__atomic_compare_exchange_n(&cache->seq, &seq, seq + 1, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    // keep the stores below from moving ahead of the odd sequence number
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (localtime_r(&sec, &tm) != NULL)
+    {
+        len = strftime(cache->text, sizeof(cache->text), cache->format, &tm);
+    }
+    cache->len = len;
+    cache->sec = sec;
+
+    __atomic_store_n(&cache->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+size_t timecache_get(struct timecache *cache, const struct timespec *now, char *buf, size_t buf_size)
+{
+    uint32_t seq;
+    size_t len;
+    time_t sec;
+
+    // seqlock style read: copy, then retry if a refresh started or finished meanwhile
+    while (true)
+    {
+        seq = __atomic_load_n(&cache->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+        {
+            continue;
+        }
+        sec = cache->sec;
+        len = cache->len;
+        if ((sec == now->tv_sec) && (len <= buf_size))
+        {
+            memcpy(buf, cache->text, len);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&cache->seq, __ATOMIC_RELAXED) != seq)
+        {
+            continue;
+        }
+
+        // a reader still on an older second may race a newer one, only move forward
+        if (sec < now->tv_sec)
+        {
+            timecache_refresh(cache, seq, now->tv_sec);
+            continue;
+        }
+        if ((sec != now->tv_sec) || (len > buf_size))
+        {
+            // behind the cache, or buf too small: format directly rather than spin
+            struct tm tm;
+            char text[TIMECACHE_TEXT_MAX];
+            if (localtime_r(&now->tv_sec, &tm) == NULL)
+            {
+                return 0;
+            }
+            len = strftime(text, sizeof(text), cache->format, &tm);
+            if (len > buf_size)
+            {
+                return 0;
+            }
+            memcpy(buf, text, len);
+        }
+        return len;
+    }
+}
@@ -0,0 +1,33 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026
+
+   Formatted wall clock time cached per second.  localtime_r() and strftime() run once
+   per second per cache, by whichever caller first notices the second changed, and every
+   other caller copies the cached text without taking a lock. */
+
+#ifndef TIMECACHE_H
+#define TIMECACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define TIMECACHE_TEXT_MAX 128
+
+struct timecache {
+    uint32_t    seq;    /* odd while the text is being rewritten */
+    time_t      sec;    /* second the text was formatted for */
+    size_t      len;
+    char        text[TIMECACHE_TEXT_MAX];
+    const char *format; /* strftime format */
+};
+
+void timecache_init(struct timecache *cache, const char *format);
+
+/* Copy the text for now->tv_sec into buf, refreshing the cache first if it holds an
+   older second.  Returns the number of bytes copied, not NUL terminated, or 0 if the
+   time could not be formatted or does not fit in buf_size. */
+size_t timecache_get(struct timecache *cache, const struct timespec *now, char *buf, size_t buf_size);
+
+#endif /* TIMECACHE_H */
@@ -0,0 +1,71 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026   */
+
+#include "timerwheel.h"
+
+void timer_wheel_init(struct timer_wheel *wheel, uint64_t now)
+{
+    size_t idx;
+
+    wheel->now = now;
+    wheel->armed = 0;
+    for (idx = 0; idx < TIMER_WHEEL_SLOTS; idx++)
+    {
+        LIST_INIT(&wheel->slots[idx]);
+    }
+}
+
+void timer_wheel_add(struct timer_wheel *wheel, struct timer_wheel_timer *timer, uint64_t expires)
+{
+    timer_wheel_del(wheel, timer);
+
+    // the current tick has already been processed, so the earliest a timer can fire is the next
+    if (expires <= wheel->now)
+    {
+        expires = wheel->now + 1;
+    }
+    timer->expires = expires;
+    timer->armed = true;
+    LIST_INSERT_HEAD(&wheel->slots[expires % TIMER_WHEEL_SLOTS], timer, entries);
+    wheel->armed++;
+}
+
+void timer_wheel_del(struct timer_wheel *wheel, struct timer_wheel_timer *timer)
+{
+    if (timer->armed)
+    {
+        LIST_REMOVE(timer, entries);
+        timer->armed = false;
+        wheel->armed--;
+    }
+}
+
+void timer_wheel_advance(struct timer_wheel *wheel, uint64_t now, timer_wheel_expired_fn expired, void *arg)
+{
+    struct timer_wheel_timer *timer;
+    struct timer_wheel_timer *next_timer;
+    uint64_t tick;
+
+    // after a gap longer than the wheel every slot is visited once, the expiry check covers the rest
+    if (now > wheel->now + TIMER_WHEEL_SLOTS)
+    {
+        wheel->now = now - TIMER_WHEEL_SLOTS;
+    }
+
+    for (tick = wheel->now + 1; tick <= now; tick++)
+    {
+        struct timer_wheel_slot *slot = &wheel->slots[tick % TIMER_WHEEL_SLOTS];
+
+        // timers re-armed from the callback land at the slot head or elsewhere, never after next_timer
+        wheel->now = tick;
+        LIST_FOREACH_SAFE(timer, slot, entries, next_timer)
+        {
+            if (timer->expires <= now)
+            {
+                timer_wheel_del(wheel, timer);
+                expired(wheel, timer, arg);
+            }
+        }
+    }
+}
@@ -0,0 +1,50 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026
+
+   Hashed timer wheel with one second ticks, used by the accept loop to enforce
+   per-connection deadlines.  Adding and removing a timer is O(1) and advancing costs
+   one slot per elapsed tick, however many connections are open.  Timers further out
+   than the wheel size stay in their slot until the wheel comes round to their tick.
+   Not thread safe, the wheel belongs to the thread that advances it. */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include "queue.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_SLOTS 64
+
+struct timer_wheel_timer {
+    uint64_t expires;   /* tick the timer is due on */
+    bool     armed;
+    LIST_ENTRY(timer_wheel_timer) entries;
+};
+
+LIST_HEAD(timer_wheel_slot, timer_wheel_timer);
+
+struct timer_wheel {
+    uint64_t now;       /* last tick processed */
+    size_t   armed;     /* number of timers in the wheel */
+    struct timer_wheel_slot slots[TIMER_WHEEL_SLOTS];
+};
+
+typedef void (*timer_wheel_expired_fn)(struct timer_wheel *wheel, struct timer_wheel_timer *timer, void *arg);
+
+void timer_wheel_init(struct timer_wheel *wheel, uint64_t now);
+
+/* Arm timer for tick expires, or for the next tick if that has already passed.
+   An armed timer is moved to the new tick. */
+void timer_wheel_add(struct timer_wheel *wheel, struct timer_wheel_timer *timer, uint64_t expires);
+
+/* Disarm timer if armed */
+void timer_wheel_del(struct timer_wheel *wheel, struct timer_wheel_timer *timer);
+
+/* Process every tick up to now, disarming and calling expired for each timer due.
+   expired may re-arm the timer it is passed and arm new ones, but must not disarm others. */
+void timer_wheel_advance(struct timer_wheel *wheel, uint64_t now, timer_wheel_expired_fn expired, void *arg);
+
+#endif /* TIMERWHEEL_H */
@@ -0,0 +1,178 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026   */
+
+#include "tls.h"
+
+#include <errno.h>
+#include <openssl/err.h>
+#include <syslog.h>
+
+#define TLS_SESSION_CACHE_SIZE  1024
+#define TLS_SESSION_TIMEOUT_S   3600
+#define TLS_SENDFILE_CHUNK      (1024 * 1024)
+
+static SSL_CTX *tls_ctx;
+
+static void tls_log_errors(const char *what)
+{
+    unsigned long err;
+    char msg[256];
+
+    syslog(LOG_ERR, "%s", what);
+    while ((err = ERR_get_error()) != 0)
+    {
+        ERR_error_string_n(err, msg, sizeof(msg));
+        syslog(LOG_ERR, "  %s", msg);
+    }
+}
+
+int tls_init(const char *cert_file, const char *key_file)
+{
+    static const unsigned char session_id_context[] = "aesdsocket";
+
+    tls_ctx = SSL_CTX_new(TLS_server_method());
+    if (!tls_ctx)
+    {
+        tls_log_errors("Unable to create TLS context");
+        return -1;
+    }
+    SSL_CTX_set_min_proto_version(tls_ctx, TLS1_2_VERSION);
+    if ((SSL_CTX_use_certificate_chain_file(tls_ctx, cert_file) != 1) ||
+        (SSL_CTX_use_PrivateKey_file(tls_ctx, key_file, SSL_FILETYPE_PEM) != 1) ||
+        (SSL_CTX_check_private_key(tls_ctx) != 1))
+    {
+        tls_log_errors("Unable to load TLS certificate or key");
+        SSL_CTX_free(tls_ctx);
+        tls_ctx = NULL;
+        return -1;
+    }
+
+    // Resumption: stateful cache for TLS 1.2 session ids, tickets for everything else.
+    // The ticket key is generated per process, so a restart costs one full handshake.
+    SSL_CTX_set_session_cache_mode(tls_ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(tls_ctx, TLS_SESSION_CACHE_SIZE);
+    SSL_CTX_set_timeout(tls_ctx, TLS_SESSION_TIMEOUT_S);
+    SSL_CTX_set_session_id_context(tls_ctx, session_id_context, sizeof(session_id_context) - 1);
+    SSL_CTX_clear_options(tls_ctx, SSL_OP_NO_TICKET);
+
+    // Client writes are small, so only the readback benefits, but kTLS also saves the
+    // copy through userspace on every send.  Silently unused if the kernel lacks it.
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(tls_ctx, SSL_OP_ENABLE_KTLS);
+#endif
+    SSL_CTX_set_mode(tls_ctx, SSL_MODE_AUTO_RETRY);
+
+    return 0;
+}
+
+SSL *tls_accept(int fd)
+{
+    SSL *ssl = SSL_new(tls_ctx);
+
+    if (!ssl)
+    {
+        tls_log_errors("Unable to create TLS connection");
+        return NULL;
+    }
+    if ((SSL_set_fd(ssl, fd) != 1) || (SSL_accept(ssl) != 1))
+    {
+        tls_log_errors("TLS handshake failed");
+        SSL_free(ssl);
+        return NULL;
+    }
+    syslog(LOG_INFO, "TLS handshake done, %s, session %s, kTLS send %s",
+           SSL_get_version(ssl), SSL_session_reused(ssl) ? "resumed" : "new",
+           tls_ktls_send(ssl) ? "on" : "off");
+    return ssl;
+}
+
+ssize_t tls_recv(SSL *ssl, void *buf, size_t len)
+{
+    size_t received = 0;
+
+    errno = 0;
+    if (SSL_read_ex(ssl, buf, len, &received) == 1)
+    {
+        return received;
+    }
+    switch (SSL_get_error(ssl, 0))
+    {
+    case SSL_ERROR_ZERO_RETURN:
+        return 0;
+    case SSL_ERROR_SYSCALL:
+        // a peer that closes without close_notify looks the same as a plain EOF
+        if (ERR_peek_error() == 0 && errno == 0)
+        {
+            return 0;
+        }
+        /* fall through */
+    default:
+        tls_log_errors("TLS receive failed");
+        return -1;
+    }
+}
+
+int tls_send_all(SSL *ssl, const void *buf, size_t len)
+{
+    size_t sent = 0;
+
+    // SSL_write_ex only returns success once all of len has been written
+    if (len && (SSL_write_ex(ssl, buf, len, &sent) != 1))
+    {
+        tls_log_errors("TLS send failed");
+        return -1;
+    }
+    return 0;
+}
+
+bool tls_ktls_send(SSL *ssl)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+    return BIO_get_ktls_send(SSL_get_wbio(ssl));
+#else
+    return false;
+#endif
+}
+
+int tls_sendfile(SSL *ssl, int fd, off_t offset, size_t len)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+    while (len)
+    {
+        size_t chunk = (len < TLS_SENDFILE_CHUNK) ? len : TLS_SENDFILE_CHUNK;
+        ossl_ssize_t sent = SSL_sendfile(ssl, fd, offset, chunk, 0);
+        if (sent <= 0)
+        {
+            if ((sent == -1) && (errno == EINTR))
+            {
+                continue;
+            }
+            tls_log_errors("TLS sendfile failed");
+            return -1;
+        }
+        offset += sent;
+        len -= sent;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void tls_close(SSL *ssl)
+{
+    if (ssl)
+    {
+        // one way close_notify, the socket is closed straight after
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+        ERR_clear_error();
+    }
+}
+
+void tls_cleanup(void)
+{
+    SSL_CTX_free(tls_ctx);
+    tls_ctx = NULL;
+}
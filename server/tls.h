@@ -0,0 +1,44 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026
+
+   Optional TLS on the client port, built in with make TLS=1.  One server context is
+   shared by every connection.  Sessions are kept in the server cache and handed to
+   clients as tickets, so a client that reconnects resumes its session rather than
+   repeating the full handshake.  Where the kernel supports it the record layer is
+   offloaded to kTLS, which lets the log readback go out with sendfile instead of being
+   encrypted in userspace. */
+
+#ifndef TLS_H
+#define TLS_H
+
+#include <openssl/ssl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Load the certificate chain and key and set up the shared context, returns 0 or -1 */
+int tls_init(const char *cert_file, const char *key_file);
+
+/* Run the server handshake on a connected socket, NULL on failure */
+SSL *tls_accept(int fd);
+
+/* Like recv(), returns bytes read, 0 when the peer closed or -1 on error */
+ssize_t tls_recv(SSL *ssl, void *buf, size_t len);
+
+/* Send all of buf, returns 0 or -1 */
+int tls_send_all(SSL *ssl, const void *buf, size_t len);
+
+/* True when records sent on ssl are encrypted by the kernel */
+bool tls_ktls_send(SSL *ssl);
+
+/* Send len bytes of fd starting at offset through kTLS, returns 0 or -1.  Only valid
+   when tls_ktls_send() is true. */
+int tls_sendfile(SSL *ssl, int fd, off_t offset, size_t len);
+
+/* Send close_notify and free the connection, the socket is left to the caller */
+void tls_close(SSL *ssl);
+
+void tls_cleanup(void);
+
+#endif /* TLS_H */
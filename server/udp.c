@@ -0,0 +1,284 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026   */
+
+// recvmmsg() is a GNU extension
+#define _GNU_SOURCE
+
+#include "udp.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+// Room for a burst while the thread is committing the previous batch
+#define UDP_RCVBUF_BYTES    (4 * 1024 * 1024)
+#define UDP_POLL_MS         1000
+
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL 40
+#endif
+
+struct udp_stats {
+    uint64_t datagrams;         /* received from the socket */
+    uint64_t records;           /* committed */
+    uint64_t dropped_kernel;    /* lost to a full socket buffer */
+    uint64_t dropped_oversize;  /* longer than UDP_RECORD_MAX */
+    uint64_t dropped_newline;   /* a newline before the last byte */
+    uint64_t dropped_commit;    /* in batches the commit function failed */
+};
+
+static struct {
+    int             fd;
+    bool            running;
+    bool            stopping;   /* set by udp_ingest_stop(), polled by the thread */
+    pthread_t       thread;
+    udp_commit_fn   commit;
+    struct udp_stats stats;     /* written only by the receive thread */
+    uint32_t        kernel_drops_seen;
+    // One buffer per record, with a byte spare to add a missing newline
+    char            buf[UDP_BATCH_RECORDS][UDP_RECORD_MAX + 1];
+    char            control[UDP_BATCH_RECORDS][CMSG_SPACE(sizeof(uint32_t))];
+    struct iovec    iov[UDP_BATCH_RECORDS];
+    struct mmsghdr  msgs[UDP_BATCH_RECORDS];
+    struct iovec    records[UDP_BATCH_RECORDS];
+} *udp;
+
+static void udp_log_stats(const struct udp_stats *stats)
+{
+    syslog(LOG_INFO, "UDP: %llu datagrams, %llu records committed, dropped %llu in the kernel, "
+           "%llu oversize, %llu with embedded newlines, %llu on commit failure",
+           (unsigned long long)stats->datagrams, (unsigned long long)stats->records,
+           (unsigned long long)stats->dropped_kernel, (unsigned long long)stats->dropped_oversize,
+           (unsigned long long)stats->dropped_newline, (unsigned long long)stats->dropped_commit);
+}
+
+/* SO_RXQ_OVFL reports the socket's running total of drops on each datagram */
+static void udp_note_kernel_drops(struct msghdr *msg)
+{
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SO_RXQ_OVFL))
+        {
+            uint32_t total;
+            memcpy(&total, CMSG_DATA(cmsg), sizeof(total));
+            udp->stats.dropped_kernel += (uint32_t)(total - udp->kernel_drops_seen);
+            udp->kernel_drops_seen = total;
+        }
+    }
+}
+
+/* Turn the received datagrams into records and commit them.  Returns the count received. */
+static int udp_drain_batch(void)
+{
+    int idx;
+    int count = 0;
+
+    for (idx = 0; idx < UDP_BATCH_RECORDS; idx++)
+    {
+        udp->iov[idx].iov_base = udp->buf[idx];
+        udp->iov[idx].iov_len = UDP_RECORD_MAX;
+        memset(&udp->msgs[idx].msg_hdr, 0, sizeof(udp->msgs[idx].msg_hdr));
+        udp->msgs[idx].msg_hdr.msg_iov = &udp->iov[idx];
+        udp->msgs[idx].msg_hdr.msg_iovlen = 1;
+        udp->msgs[idx].msg_hdr.msg_control = udp->control[idx];
+        udp->msgs[idx].msg_hdr.msg_controllen = sizeof(udp->control[idx]);
+    }
+
+    int received = recvmmsg(udp->fd, udp->msgs, UDP_BATCH_RECORDS, MSG_DONTWAIT, NULL);
+    if (received <= 0)
+    {
+        return received;
+    }
+    udp->stats.datagrams += received;
+
+    for (idx = 0; idx < received; idx++)
+    {
+        struct msghdr *hdr = &udp->msgs[idx].msg_hdr;
+        size_t len = udp->msgs[idx].msg_len;
+
+        udp_note_kernel_drops(hdr);
+        if (hdr->msg_flags & MSG_TRUNC)
+        {
+            udp->stats.dropped_oversize++;
+            continue;
+        }
+        if (len == 0)
+        {
+            continue;
+        }
+        // a newline inside would split the datagram into several records in the log
+        if (memchr(udp->buf[idx], '\n', len - 1) != NULL)
+        {
+            udp->stats.dropped_newline++;
+            continue;
+        }
+        // one record per datagram, so the newline is implied when the sender leaves it off
+        if (udp->buf[idx][len - 1] != '\n')
+        {
+            udp->buf[idx][len++] = '\n';
+        }
+        udp->records[count].iov_base = udp->buf[idx];
+        udp->records[count].iov_len = len;
+        count++;
+    }
+
+    if (count)
+    {
+        if (udp->commit(udp->records, count) == 0)
+        {
+            udp->stats.records += count;
+        }
+        else
+        {
+            udp->stats.dropped_commit += count;
+        }
+    }
+    return received;
+}
+
+static void *udp_receiver(void *arg)
+{
+    struct pollfd pfd = { .fd = udp->fd, .events = POLLIN };
+    struct udp_stats logged = { 0 };
+    struct timespec now;
+    time_t next_log = 0;
+    sigset_t mask;
+
+    // leave SIGINT/SIGTERM to the accept loop
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    while (!__atomic_load_n(&udp->stopping, __ATOMIC_RELAXED))
+    {
+        int ret = poll(&pfd, 1, UDP_POLL_MS);
+        if ((ret == -1) && (errno != EINTR))
+        {
+            syslog(LOG_ERR, "Error polling UDP socket");
+            break;
+        }
+        // keep draining while full batches come back, the socket is still backed up
+        while ((ret > 0) && (udp_drain_batch() == UDP_BATCH_RECORDS))
+        {
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec >= next_log) &&
+            ((udp->stats.dropped_kernel != logged.dropped_kernel) ||
+             (udp->stats.dropped_oversize != logged.dropped_oversize) ||
+             (udp->stats.dropped_newline != logged.dropped_newline) ||
+             (udp->stats.dropped_commit != logged.dropped_commit)))
+        {
+            udp_log_stats(&udp->stats);
+            logged = udp->stats;
+            next_log = now.tv_sec + UDP_STATS_INTERVAL_S;
+        }
+    }
+    return NULL;
+}
+
+int udp_ingest_start(const char *port, udp_commit_fn commit)
+{
+    struct addrinfo hints;
+    struct addrinfo *addrs;
+    struct addrinfo *addr;
+    int one = 1;
+    int rcvbuf = UDP_RCVBUF_BYTES;
+
+    udp = calloc(1, sizeof(*udp));
+    if (!udp)
+    {
+        syslog(LOG_ERR, "Unable to allocate UDP buffers");
+        return -1;
+    }
+    udp->fd = -1;
+    udp->commit = commit;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(NULL, port, &hints, &addrs) != 0)
+    {
+        syslog(LOG_ERR, "Error getting UDP address info");
+        goto fail;
+    }
+    for (addr = addrs; addr; addr = addr->ai_next)
+    {
+        udp->fd = socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC, addr->ai_protocol);
+        if (udp->fd == -1)
+        {
+            continue;
+        }
+        if ((setsockopt(udp->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0) &&
+            (bind(udp->fd, addr->ai_addr, addr->ai_addrlen) == 0))
+        {
+            break;
+        }
+        close(udp->fd);
+        udp->fd = -1;
+    }
+    freeaddrinfo(addrs);
+    if (udp->fd == -1)
+    {
+        syslog(LOG_ERR, "Error binding UDP port %s", port);
+        goto fail;
+    }
+
+    // both best effort, the kernel caps the buffer at rmem_max
+    setsockopt(udp->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (setsockopt(udp->fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) != 0)
+    {
+        syslog(LOG_WARNING, "Kernel UDP drops will not be counted");
+    }
+
+    if (pthread_create(&udp->thread, NULL, udp_receiver, NULL) != 0)
+    {
+        syslog(LOG_ERR, "Error creating UDP thread");
+        goto fail;
+    }
+    udp->running = true;
+    return 0;
+
+fail:
+    if (udp->fd != -1)
+    {
+        close(udp->fd);
+    }
+    free(udp);
+    udp = NULL;
+    return -1;
+}
+
+void udp_ingest_stop(void)
+{
+    if (!udp)
+    {
+        return;
+    }
+    if (udp->running)
+    {
+        // shutdown wakes the thread's poll rather than leaving it to time out
+        __atomic_store_n(&udp->stopping, true, __ATOMIC_RELAXED);
+        shutdown(udp->fd, SHUT_RDWR);
+        pthread_join(udp->thread, NULL);
+        udp_log_stats(&udp->stats);
+    }
+    close(udp->fd);
+    free(udp);
+    udp = NULL;
+}
@@ -0,0 +1,37 @@
+/* CU AESD aesdsocket
+   Katie Biggs
+   October 19, 2026
+
+   Fire and forget ingestion over UDP.  Every datagram is one record; there is no
+   handshake and nothing is sent back.  A datagram may end in a newline but must not
+   contain one anywhere else, since that would become several records in the log.  A single thread drains the socket with
+   recvmmsg(), up to UDP_BATCH_RECORDS datagrams per call, and hands each batch to the
+   commit function in one go, so the log is opened and locked once per batch rather
+   than once per record.
+
+   Records that never make it are counted rather than logged one by one: datagrams
+   the kernel dropped because the socket buffer was full (from SO_RXQ_OVFL), datagrams
+   too large for a record buffer, datagrams with an embedded newline, and batches the
+   commit function rejected.  The
+   counters are logged when they change, at most every UDP_STATS_INTERVAL_S, and at
+   stop. */
+
+#ifndef UDP_H
+#define UDP_H
+
+#include <sys/uio.h>
+
+#define UDP_BATCH_RECORDS       64
+#define UDP_RECORD_MAX          4096
+#define UDP_STATS_INTERVAL_S    10
+
+/* Commits count records, each one iovec ending in a newline.  Returns 0 or -1. */
+typedef int (*udp_commit_fn)(const struct iovec *records, int count);
+
+/* Bind port and start the receive thread.  Returns 0 or -1. */
+int udp_ingest_start(const char *port, udp_commit_fn commit);
+
+/* Stop the receive thread and log the final counters */
+void udp_ingest_stop(void);
+
+#endif /* UDP_H */
@@ -0,0 +1,146 @@
+#include "unity.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+/**
+* Covers the monotonic positions the driver addresses entries by: out_fpos, in_fpos and
+* out_seq across wraparound, lookups after eviction and aesd_circular_buffer_remove_entry().
+* Everything is written in terms of AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, so the tests
+* also hold when the capacity is overridden at build time.
+*/
+
+#define TEST_ENTRIES_ADDED (3 * AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED + 3)
+
+// entry n holds n + 1 bytes, so every entry has a different size and start offset
+static char test_payload[TEST_ENTRIES_ADDED][TEST_ENTRIES_ADDED + 1];
+
+static size_t test_entry_size(size_t n)
+{
+    return n + 1;
+}
+
+// absolute offset of the first byte of entry n
+static uint64_t test_entry_start(size_t n)
+{
+    return (uint64_t)n * (n + 1) / 2;
+}
+
+static void test_add_entries(struct aesd_circular_buffer *buffer, size_t first, size_t count)
+{
+    for (size_t n = first; n < first + count; n++)
+    {
+        struct aesd_buffer_entry entry;
+
+        memset(test_payload[n], 'a' + (n % 26), test_entry_size(n));
+        entry.buffptr = test_payload[n];
+        entry.size = test_entry_size(n);
+        aesd_circular_buffer_add_entry(buffer, &entry);
+    }
+}
+
+void test_circular_buffer_positions_wraparound()
+{
+    struct aesd_circular_buffer buffer;
+
+    aesd_circular_buffer_init(&buffer);
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(0, aesd_circular_buffer_entry_count(&buffer), "A new buffer is empty");
+
+    for (size_t n = 0; n < TEST_ENTRIES_ADDED; n++)
+    {
+        size_t held = (n + 1 < AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED) ? n + 1 : AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+        size_t oldest = n + 1 - held;
+
+        test_add_entries(&buffer, n, 1);
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(held, aesd_circular_buffer_entry_count(&buffer),
+                                        "Entry count grows to the capacity and stays there");
+        TEST_ASSERT_EQUAL_MESSAGE(held == AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, buffer.full,
+                                  "The buffer is full once it holds its capacity");
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(oldest, buffer.out_seq, "out_seq numbers the oldest entry held");
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(test_entry_start(oldest), buffer.out_fpos,
+                                         "out_fpos counts every byte evicted");
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(test_entry_start(n + 1), buffer.in_fpos,
+                                         "in_fpos counts every byte ever added");
+        TEST_ASSERT_EQUAL_PTR_MESSAGE(test_payload[oldest], buffer.entry[buffer.out_offs].buffptr,
+                                      "out_offs points at the oldest entry held");
+    }
+}
+
+void test_circular_buffer_positions_lookup_after_eviction()
+{
+    struct aesd_circular_buffer buffer;
+    size_t oldest = TEST_ENTRIES_ADDED - AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+    size_t entry_offset = 0;
+    char message[96];
+
+    aesd_circular_buffer_init(&buffer);
+    test_add_entries(&buffer, 0, TEST_ENTRIES_ADDED);
+
+    // every byte still held is found in the entry that holds it, at the right offset
+    for (size_t n = oldest; n < TEST_ENTRIES_ADDED; n++)
+    {
+        for (size_t byte = 0; byte < test_entry_size(n); byte++)
+        {
+            uint64_t char_offset = test_entry_start(n) + byte - buffer.out_fpos;
+            struct aesd_buffer_entry *entry;
+
+            snprintf(message, sizeof(message), "entry %zu byte %zu", n, byte);
+            entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, char_offset, &entry_offset);
+            TEST_ASSERT_NOT_NULL_MESSAGE(entry, message);
+            TEST_ASSERT_EQUAL_PTR_MESSAGE(test_payload[n], entry->buffptr, message);
+            TEST_ASSERT_EQUAL_size_t_MESSAGE(byte, entry_offset, message);
+        }
+    }
+
+    // one past the newest byte is not available yet
+    TEST_ASSERT_NULL_MESSAGE(aesd_circular_buffer_find_entry_offset_for_fpos(&buffer,
+                                 buffer.in_fpos - buffer.out_fpos, &entry_offset),
+                             "Nothing is found past the newest byte");
+}
+
+void test_circular_buffer_positions_remove_entry()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry removed;
+    size_t oldest = TEST_ENTRIES_ADDED - AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+    size_t entry_offset = 0;
+    struct aesd_buffer_entry *entry;
+
+    aesd_circular_buffer_init(&buffer);
+    TEST_ASSERT_FALSE_MESSAGE(aesd_circular_buffer_remove_entry(&buffer, &removed),
+                              "Nothing can be removed from an empty buffer");
+
+    test_add_entries(&buffer, 0, TEST_ENTRIES_ADDED);
+    TEST_ASSERT_TRUE(aesd_circular_buffer_remove_entry(&buffer, &removed));
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(test_payload[oldest], removed.buffptr, "The oldest entry is removed");
+    TEST_ASSERT_EQUAL_size_t(test_entry_size(oldest), removed.size);
+    TEST_ASSERT_FALSE_MESSAGE(buffer.full, "A full buffer has room after a removal");
+    TEST_ASSERT_EQUAL_UINT8(AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED - 1, aesd_circular_buffer_entry_count(&buffer));
+    TEST_ASSERT_EQUAL_UINT64(oldest + 1, buffer.out_seq);
+    TEST_ASSERT_EQUAL_UINT64(test_entry_start(oldest + 1), buffer.out_fpos);
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(test_entry_start(TEST_ENTRIES_ADDED), buffer.in_fpos,
+                                     "Removing does not move in_fpos");
+
+    // lookups now start at the entry after the one removed
+    entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, 0, &entry_offset);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL_PTR(test_payload[oldest + 1], entry->buffptr);
+    TEST_ASSERT_EQUAL_size_t(0, entry_offset);
+
+    // the freed slot is filled without evicting anything
+    test_add_entries(&buffer, TEST_ENTRIES_ADDED - 1, 1);
+    TEST_ASSERT_TRUE(buffer.full);
+    TEST_ASSERT_EQUAL_UINT64(oldest + 1, buffer.out_seq);
+
+    // removing everything leaves an empty buffer at the newest position
+    for (size_t n = 0; n < AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED; n++)
+    {
+        TEST_ASSERT_TRUE(aesd_circular_buffer_remove_entry(&buffer, NULL));
+    }
+    TEST_ASSERT_FALSE(aesd_circular_buffer_remove_entry(&buffer, &removed));
+    TEST_ASSERT_EQUAL_UINT8(0, aesd_circular_buffer_entry_count(&buffer));
+    TEST_ASSERT_EQUAL_UINT64(buffer.in_fpos, buffer.out_fpos);
+    TEST_ASSERT_NULL(aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, 0, &entry_offset));
+}
@@ -0,0 +1,117 @@
+#include "unity.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-delim.h"
+
+/**
+* Checks aesd_delim_scan(), whichever vector variant the CPU selects, against a plain memchr
+* walk over blocks of every length around the vector widths, at every alignment, with the
+* positions array both large enough and too small to hold every match.
+*/
+
+#define TEST_DELIM_BLOCK_MAX 200
+#define TEST_DELIM_POSITIONS 64
+
+static size_t test_delim_reference(const char *data, size_t size, char delimiter,
+                                   size_t *positions, size_t max_positions)
+{
+    size_t found = 0;
+    const char *match = data;
+
+    while ((found < max_positions) && (match = memchr(match, delimiter, size - (match - data))))
+    {
+        positions[found++] = match - data;
+        match++;
+    }
+    return found;
+}
+
+static void test_delim_compare(const char *data, size_t size, size_t max_positions, const char *what)
+{
+    size_t expected[TEST_DELIM_POSITIONS];
+    size_t actual[TEST_DELIM_POSITIONS];
+    char message[96];
+    size_t expected_count = test_delim_reference(data, size, '\n', expected, max_positions);
+    size_t actual_count = aesd_delim_scan(data, size, '\n', actual, max_positions);
+
+    snprintf(message, sizeof(message), "%s, %zu bytes, room for %zu", what, size, max_positions);
+    TEST_ASSERT_EQUAL_size_t_MESSAGE(expected_count, actual_count, message);
+    for (size_t idx = 0; idx < expected_count; idx++)
+    {
+        TEST_ASSERT_EQUAL_size_t_MESSAGE(expected[idx], actual[idx], message);
+    }
+}
+
+void test_delim_scan_matches_memchr()
+{
+    static const size_t room[] = { 1, 3, 16, TEST_DELIM_POSITIONS };
+    // 64 extra bytes so every block can start at each offset within a cache line
+    char storage[TEST_DELIM_BLOCK_MAX + 64];
+
+    srand(7);
+    for (int pattern = 0; pattern < 4; pattern++)
+    {
+        for (size_t idx = 0; idx < sizeof(storage); idx++)
+        {
+            switch (pattern)
+            {
+            case 0:     // no delimiters at all
+                storage[idx] = 'x';
+                break;
+            case 1:     // nothing but delimiters
+                storage[idx] = '\n';
+                break;
+            case 2:     // sparse, with neighbouring bytes that differ from '\n' by one bit
+                storage[idx] = (rand() % 23 == 0) ? '\n' : ((rand() % 2) ? '\x0b' : '\x8a');
+                break;
+            default:    // dense
+                storage[idx] = (rand() % 3 == 0) ? '\n' : (char)(rand() % 256);
+                break;
+            }
+        }
+        for (size_t align = 0; align < 64; align++)
+        {
+            for (size_t size = 0; size <= TEST_DELIM_BLOCK_MAX; size++)
+            {
+                for (size_t r = 0; r < sizeof(room) / sizeof(room[0]); r++)
+                {
+                    char what[32];
+
+                    snprintf(what, sizeof(what), "pattern %d, align %zu", pattern, align);
+                    test_delim_compare(storage + align, size, room[r], what);
+                }
+            }
+        }
+    }
+}
+
+void test_delim_scan_resumes_after_full_batch()
+{
+    char block[TEST_DELIM_BLOCK_MAX];
+    size_t positions[AESD_DELIM_SCAN_BATCH];
+    size_t offset = 0;
+    size_t total = 0;
+    size_t count;
+
+    // a full positions array means scan again from one past the last position
+    for (size_t idx = 0; idx < sizeof(block); idx++)
+    {
+        block[idx] = (idx % 3 == 2) ? '\n' : 'a';
+    }
+    do
+    {
+        count = aesd_delim_scan(block + offset, sizeof(block) - offset, '\n', positions, AESD_DELIM_SCAN_BATCH);
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            TEST_ASSERT_EQUAL_size_t(3 * total + 2, offset + positions[idx]);
+            total++;
+        }
+        if (count)
+        {
+            offset += positions[count - 1] + 1;
+        }
+    } while (count == AESD_DELIM_SCAN_BATCH);
+    TEST_ASSERT_EQUAL_size_t_MESSAGE(sizeof(block) / 3, total, "Every delimiter is found exactly once");
+}